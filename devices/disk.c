@@ -7,6 +7,7 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/workqueue.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -95,6 +96,7 @@ static void select_device (const struct disk *);
 static void select_device_wait (const struct disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static void report_unexpected_interrupt (void *channel);
 
 /* Initialize the disk subsystem and detect disks. */
 void
@@ -522,13 +524,24 @@ interrupt_handler (struct intr_frame *f) {
 				inb (reg_status (c));               /* Acknowledge interrupt. */
 				sema_up (&c->completion_wait);      /* Wake up waiter. */
 			} else
-				printf ("%s: unexpected interrupt\n", c->name);
+				work_queue (report_unexpected_interrupt, c);
 			return;
 		}
 
 	NOT_REACHED ();
 }
 
+/* Reports an interrupt that CHANNEL raised while no command was
+   outstanding.  Deferred out of interrupt_handler(), since
+   printing to the console with interrupts off stalls the whole
+   system until the message has gone out. */
+static void
+report_unexpected_interrupt (void *channel) {
+	struct channel *c = channel;
+
+	printf ("%s: unexpected interrupt\n", c->name);
+}
+
 static void
 inspect_read_cnt (struct intr_frame *f) {
 	struct disk * d = disk_get (f->R.rdx, f->R.rcx);
@@ -1,10 +1,13 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <intrinsic.h>
 #include <round.h>
 #include <stdio.h>
+#include "threads/apic.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/seqlock.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
@@ -20,62 +23,247 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+/* Guards TICKS together with the dynamic-tick state below, so
+   that timer_ticks() can read them without turning interrupts
+   off.  Only the timer interrupt and the idle thread write them. */
+static struct seqlock ticks_seq = SEQLOCK_INITIALIZER;
+
+/* TSC clocksource.  TSC_HZ is the TSC frequency, measured by
+   timer_calibrate(), and TSC_MULT the length of a TSC cycle in
+   nanoseconds as a 32.32 fixed-point number, so that reading the
+   clock takes a multiply and a shift rather than a division.
+   TSC_BASE is the TSC value that clock_now_ns() counts from. */
+static uint64_t tsc_hz;
+static uint64_t tsc_mult;
+static uint64_t tsc_base;
+
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_TICK (NSEC_PER_SEC / TIMER_FREQ)
+
+/* Sub-tick sleeps shorter than this spin on the TSC instead of
+   blocking, since two thread switches and a reprogrammed tick
+   source would cost about as much as the sleep itself. */
+#define SPIN_MAX_NS 20000
+
+/* If true, the idle thread stops the periodic tick and programs
+   the tick source in one-shot mode for the next timer deadline.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* 8254 input clocks per timer tick. */
+#define PIT_HZ 1193180
+#define PIT_TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Tick source: PIT counter 0, or, when the APIC handles
+   interrupts, the local APIC timer, which is cheaper to program
+   and read and which every CPU has its own of.  TICK_COUNT is
+   the number of the source's input clocks per tick, and
+   ONESHOT_MAX_TICKS the longest one-shot interval, in ticks, that
+   fits in its counter. */
+static bool lapic_tick;
+static unsigned tick_count = PIT_TICK_COUNT;
+static int64_t oneshot_max_ticks = 0xffff / PIT_TICK_COUNT;
+
+/* Once timer_calibrate() knows TSC_HZ, a local APIC timer that
+   has TSC-deadline mode switches to it, and its input clock
+   becomes the TSC itself, so one-shots for high-resolution
+   timers are exact to a cycle instead of to the bus clock / 16.
+   That mode has no counter and no periodic mode: TICK_DEADLINE
+   is the TSC value the timer is armed for, the count left is read
+   off it, and timer_interrupt() arms each periodic tick. */
+static bool tsc_deadline_tick;
+static uint64_t tick_deadline;
+
+/* Dynamic-tick state.  ONESHOT_CLOCKS is nonzero while the tick
+   source is in one-shot mode and holds the number of input clocks
+   it was armed for: a whole number of ticks when the idle thread
+   stopped the tick, or less than one when a high-resolution timer
+   is due before the next tick.  TICK_RESIDUE accumulates input
+   clocks that elapsed but did not add up to a whole tick when
+   switching modes, so that the tick count does not drift. */
+static uint64_t oneshot_clocks;
+static uint64_t tick_residue;
+
+/* Pending high-resolution timers, in two heaps.  HRTIMER_QUEUE
+   has the earliest deadline on top: whenever that one is due
+   before the tick source's next interrupt, the tick source is
+   rearmed in one-shot mode for its deadline.  HRTIMER_SOFT_QUEUE
+   has the earliest start of range on top, so that a timer
+   interrupt finds every timer whose range has begun, even one
+   with a later deadline than a timer whose range has not.  Only
+   touched with interrupts off. */
+static struct heap hrtimer_queue;
+static struct heap hrtimer_soft_queue;
+
+/* Hierarchical timer wheel holding the armed kernel timers.
+
+   Timers due within the next TVR_SIZE ticks hang off tv1, one
+   slot per tick.  Timers further out go into one of the
+   TVN_LEVELS coarser wheels in tvn[], each slot of which covers
+   TVR_SIZE * TVN_SIZE^LEVEL ticks.  Whenever tv1 wraps around,
+   the next slot of the coarser wheels is "cascaded" down into
+   the finer ones.  Arming and cancelling a timer is O(1), and a
+   tick only touches the timers that actually expire, plus an
+   amortized constant for cascading, no matter how many timers
+   are armed.  The wheel is only touched with interrupts off. */
+#define TVR_BITS 8
+#define TVN_BITS 6
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVN_MASK (TVN_SIZE - 1)
+#define TVN_LEVELS 4
+#define WHEEL_MAX_OFFSET ((1LL << (TVR_BITS + TVN_LEVELS * TVN_BITS)) - 1)
+
+static struct list tv1[TVR_SIZE];
+static struct list tvn[TVN_LEVELS][TVN_SIZE];
+static int64_t wheel_ticks;     /* Next tick the wheel will process. */
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
-static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
-
-static struct list sleep_list; // Alarm clock 개선
-
-
-/* Sets up the 8254 Programmable Interval Timer (PIT) to
-   interrupt PIT_FREQ times per second, and registers the
-   corresponding interrupt. */
+static bool hrtimer_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+static bool hrtimer_soft_less (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+static void hrtimer_run (void);
+static void hrtimer_reprogram (void);
+static void hrtimer_sleep (uint64_t deadline, uint64_t slack);
+static void hrtimer_wakeup (void *t);
+static void wheel_insert (struct timer *);
+static void wheel_run (int64_t now);
+static int64_t wheel_next_expiry (int64_t limit);
+static void tick_set_periodic (void);
+static void tick_set_oneshot (uint32_t count);
+static uint32_t tick_read_count (void);
+static void oneshot_arm (uint64_t clocks);
+static bool oneshot_expired (void);
+static unsigned lapic_calibrate (void);
+static void tsc_deadline_start (void);
+static void deadline_set_periodic (void);
+static void deadline_next_tick (void);
+static uint32_t deadline_read_count (void);
+static void pit_set_periodic (void);
+static void pit_set_oneshot (uint16_t count);
+static uint16_t pit_read_count (void);
+static void pit_gate_start (uint16_t count);
+static bool pit_gate_done (void);
+static int64_t oneshot_elapsed (uint64_t *residue);
+
+
+/* Sets up the tick source, normally the 8254 Programmable
+   Interval Timer (PIT), to interrupt TIMER_FREQ times per second,
+   and registers the corresponding interrupt. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+	int i, j;
+
+	for (i = 0; i < TVR_SIZE; i++)
+		list_init (&tv1[i]);
+	for (i = 0; i < TVN_LEVELS; i++)
+		for (j = 0; j < TVN_SIZE; j++)
+			list_init (&tvn[i][j]);
+	heap_init (&hrtimer_queue, hrtimer_less, NULL);
+	heap_init (&hrtimer_soft_queue, hrtimer_soft_less, NULL);
+
+	/* With the APIC, the local APIC timer takes over IRQ 0's
+	   vector and the PIT is silenced. */
+	if (intr_apic) {
+		lapic_tick = true;
+		tick_count = lapic_calibrate ();
+		oneshot_max_ticks = UINT32_MAX / tick_count;
+		ioapic_mask_irq (0, true);
+	}
+	tick_set_periodic ();
 
-	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+	intr_register_ext (0x20, timer_interrupt,
+			lapic_tick ? "LAPIC Timer" : "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates the TSC clocksource behind clock_now_ns(), used for
+   sub-tick delays and high-resolution timers, by timing it
+   against a single 10 ms run of PIT counter 2. */
 void
 timer_calibrate (void) {
-	unsigned high_bit, test_bit;
+	uint32_t eax = 0x80000000, ebx, ecx = 0, edx = 0;
+	enum intr_level old_level;
+	uint64_t start, end;
+	bool invariant;
 
 	ASSERT (intr_get_level () == INTR_ON);
 	printf ("Calibrating timer...  ");
 
-	/* Approximate loops_per_tick as the largest power-of-two
-	   still less than one timer tick. */
-	loops_per_tick = 1u << 10;
-	while (!too_many_loops (loops_per_tick << 1)) {
-		loops_per_tick <<= 1;
-		ASSERT (loops_per_tick != 0);
-	}
-
-	/* Refine the next 8 bits of loops_per_tick. */
-	high_bit = loops_per_tick;
-	for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-		if (!too_many_loops (high_bit | test_bit))
-			loops_per_tick |= test_bit;
+	/* With interrupts off, so that no handler stretches either
+	   end of the interval. */
+	old_level = intr_disable ();
+	pit_gate_start (PIT_HZ / 100);
+	start = rdtsc ();
+	while (!pit_gate_done ())
+		continue;
+	end = rdtsc ();
+	tsc_hz = (end - start) * PIT_HZ / (PIT_HZ / 100);
+	tsc_mult = ((uint64_t) NSEC_PER_SEC << 32) / tsc_hz;
+	tsc_base = end;
+	if (lapic_tick && lapic_has_tsc_deadline () && oneshot_clocks == 0)
+		tsc_deadline_start ();
+	intr_set_level (old_level);
 
-	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+	/* An invariant TSC ticks at the same rate in every P- and
+	   C-state.  Without one the clock may run slow while the CPU
+	   is throttled, which only makes sub-tick sleeps longer. */
+	asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+	if (eax >= 0x80000007) {
+		eax = 0x80000007;
+		asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+	} else
+		edx = 0;
+	invariant = (edx & (1 << 8)) != 0;
+
+	printf ("%'"PRIu64" TSC cycles/s%s.\n", tsc_hz,
+			invariant ? "" : " (not invariant)");
+	if (tsc_deadline_tick)
+		printf ("Local APIC timer in TSC-deadline mode.\n");
 }
 
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) {
+	uint64_t oneshot;
+	unsigned seq;
+	int64_t t;
+
+	do {
+		seq = seqlock_read_begin (&ticks_seq);
+		t = ticks;
+		oneshot = oneshot_clocks;
+	} while (seqlock_read_retry (&ticks_seq, seq));
+
+	if (oneshot > 0) {
+		/* The tick source is in one-shot mode; count what has
+		   elapsed.  That happens while idle, with the periodic
+		   tick stopped, but also while any thread runs, when a
+		   high-resolution timer is due before the next tick.
+		   Interrupts go off because the timer interrupt or
+		   hrtimer_reprogram() may otherwise reprogram the tick
+		   source, or leave one-shot mode, between reading it and
+		   reading TICKS. */
+		enum intr_level old_level = intr_disable ();
+		t = ticks;
+		if (oneshot_clocks > 0) {
+			uint64_t residue = tick_residue;
+			t += oneshot_elapsed (&residue);
+		}
+		intr_set_level (old_level);
+	}
+	return t;
+}
+
+/* Returns the tick counter the way timer_ticks() read it before
+   it used a seqlock, by turning interrupts off around the read.
+   Only seqlock-bench uses this, as its baseline.  It does not
+   count ticks that pass while the periodic tick is stopped, which
+   only happens while the CPU is idle. */
+int64_t
+timer_ticks_intr_off (void) {
 	enum intr_level old_level = intr_disable ();
 	int64_t t = ticks;
 	intr_set_level (old_level);
@@ -90,6 +278,15 @@ timer_elapsed (int64_t then) {
 	return timer_ticks () - then;
 }
 
+/* Returns the number of nanoseconds since timer_calibrate(),
+   read from the TSC, or 0 before it. */
+uint64_t
+clock_now_ns (void) {
+	uint64_t cycles = rdtsc () - tsc_base;
+
+	return ((unsigned __int128) cycles * tsc_mult) >> 32;
+}
+
 /* Suspends execution for approximately TICKS timer ticks. */
 void timer_sleep(int64_t ticks) {
 	int64_t start = timer_ticks ();
@@ -97,6 +294,8 @@ void timer_sleep(int64_t ticks) {
 	ASSERT (intr_get_level () == INTR_ON);
 	// while (timer_elapsed (start) < ticks)
 	// 	thread_yield ();
+	if (ticks <= 0)
+		return;
 	thread_sleep(start + ticks);
 }
 void
@@ -129,6 +328,208 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Initializes kernel timer T to call FUNC (AUX) when it
+   expires.  The timer is not armed until timer_add(). */
+void
+timer_setup (struct timer *t, timer_func *func, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (func != NULL);
+
+	t->expires = 0;
+	t->func = func;
+	t->aux = aux;
+	t->pending = false;
+}
+
+/* Arms T to fire at tick EXPIRES.  If EXPIRES has already
+   passed, T fires at the next timer tick.  T must not already be
+   pending.  May be called from an interrupt handler, including
+   from another timer's function. */
+void
+timer_add (struct timer *t, int64_t expires) {
+	enum intr_level old_level;
+
+	ASSERT (t != NULL);
+	ASSERT (t->func != NULL);
+
+	old_level = intr_disable ();
+	ASSERT (!t->pending);
+	t->expires = expires;
+	t->pending = true;
+	wheel_insert (t);
+	intr_set_level (old_level);
+}
+
+/* Like timer_add(), but lets T fire up to SLACK ticks after
+   EXPIRES.  T then fires at the tick within that range that is a
+   multiple of the highest possible power of two, so that timers
+   with nearby deadlines and enough slack land on the same tick
+   and fire in one batch. */
+void
+timer_add_slack (struct timer *t, int64_t expires, int64_t slack) {
+	ASSERT (slack >= 0);
+
+	if (slack > 0) {
+		int64_t limit = expires + slack;
+		int bit = 63 - __builtin_clzll (expires ^ limit);
+
+		/* LIMIT has a 1 and EXPIRES a 0 at BIT, the highest bit
+		   where they differ, so clearing LIMIT's bits below it
+		   stays within [EXPIRES, LIMIT]. */
+		expires = limit & ~((1LL << bit) - 1);
+	}
+	timer_add (t, expires);
+}
+
+/* Disarms T.  Returns true if T was pending, false if it had
+   already fired or was never armed. */
+bool
+timer_cancel (struct timer *t) {
+	enum intr_level old_level;
+	bool was_pending;
+
+	ASSERT (t != NULL);
+
+	old_level = intr_disable ();
+	was_pending = t->pending;
+	if (was_pending) {
+		list_remove (&t->elem);
+		t->pending = false;
+	}
+	intr_set_level (old_level);
+
+	return was_pending;
+}
+
+/* Returns true if T is armed and has not fired yet. */
+bool
+timer_pending (const struct timer *t) {
+	return t->pending;
+}
+
+/* Initializes high-resolution timer T to call FUNC (AUX) when it
+   expires.  The timer is not armed until hrtimer_add(). */
+void
+hrtimer_setup (struct hrtimer *t, timer_func *func, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (func != NULL);
+
+	t->soft_expires = t->expires = 0;
+	t->func = func;
+	t->aux = aux;
+	t->pending = false;
+}
+
+/* Arms T to fire once clock_now_ns() reaches EXPIRES.  If EXPIRES
+   has already passed, T fires at the next timer interrupt.  T
+   must not already be pending.  May be called from an interrupt
+   handler. */
+void
+hrtimer_add (struct hrtimer *t, uint64_t expires) {
+	hrtimer_add_range (t, expires, 0);
+}
+
+/* Like hrtimer_add(), but lets T fire as late as EXPIRES + SLACK.
+   The tick source is only ever armed for that later time, and
+   whenever a timer interrupt comes, every timer whose range has
+   begun fires with it, so timers with overlapping ranges cost one
+   interrupt between them. */
+void
+hrtimer_add_range (struct hrtimer *t, uint64_t expires, uint64_t slack) {
+	enum intr_level old_level;
+
+	ASSERT (t != NULL);
+	ASSERT (t->func != NULL);
+
+	old_level = intr_disable ();
+	ASSERT (!t->pending);
+	t->soft_expires = expires;
+	t->expires = expires + slack;
+	t->pending = true;
+	heap_push (&hrtimer_queue, &t->elem);
+	heap_push (&hrtimer_soft_queue, &t->soft_elem);
+	if (heap_top (&hrtimer_queue) == &t->elem)
+		hrtimer_reprogram ();
+	intr_set_level (old_level);
+}
+
+/* Disarms T.  Returns true if T was pending, false if it had
+   already fired or was never armed.  An interrupt the tick source
+   was armed for on T's behalf still comes, and finds nothing to
+   do. */
+bool
+hrtimer_cancel (struct hrtimer *t) {
+	enum intr_level old_level;
+	bool was_pending;
+
+	ASSERT (t != NULL);
+
+	old_level = intr_disable ();
+	was_pending = t->pending;
+	if (was_pending) {
+		heap_remove (&hrtimer_queue, &t->elem);
+		heap_remove (&hrtimer_soft_queue, &t->soft_elem);
+		t->pending = false;
+	}
+	intr_set_level (old_level);
+
+	return was_pending;
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, stops the periodic tick and arms the
+   tick source to fire once at the earliest pending timer
+   deadline, or after the longest interval it can count, whichever comes
+   first.  A high-resolution timer due before then still
+   shortens the one-shot. */
+void
+timer_idle_enter (void) {
+	int64_t next, n;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!timer_tickless || oneshot_clocks > 0)
+		return;
+
+	/* The timer in slot T fires when TICKS reaches T. */
+	next = wheel_next_expiry (oneshot_max_ticks);
+	n = next - ticks;
+	if (n < 2)
+		return;
+
+	oneshot_arm ((uint64_t) n * tick_count);
+	hrtimer_reprogram ();
+}
+
+/* Leaves one-shot mode, if the tick source is in it, and goes back to the
+   periodic tick, crediting the ticks that elapsed meanwhile.
+   Called with interrupts off when the idle thread is switched
+   out, which happens as soon as any interrupt made a thread
+   ready.  No timer can have expired in between, because the
+   one-shot was armed for the earliest deadline; if the one-shot
+   itself already ran out, its interrupt is still pending and is
+   left to account the elapsed ticks and run the expired
+   timers. */
+void
+timer_idle_exit (void) {
+	enum intr_level old_level;
+	int64_t elapsed;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (oneshot_clocks == 0 || oneshot_expired ())
+		return;
+
+	old_level = seqlock_write_lock (&ticks_seq);
+	elapsed = oneshot_elapsed (&tick_residue);
+	ticks += elapsed;
+	oneshot_clocks = 0;
+	tick_set_periodic ();
+	seqlock_write_unlock (&ticks_seq, old_level);
+	thread_account_idle (elapsed);
+	hrtimer_reprogram ();
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) {
@@ -138,44 +539,445 @@ timer_print_stats (void) {
 
 /* Timer interrupt handler. */
 /* 매 tick마다 timer 인터럽트 시 호출되는 함수
-     sleep queue에서 깨어날 thread가 있는지 확인.
+     timer wheel에서 만료된 타이머(잠든 스레드 깨우기 등)를 처리.
 */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
-	ticks++;
-	thread_tick ();
-    thread_check_sleep_list(); // 커널이 이 인터럽트 호출 시 리스트를 확인 & 깨우기
+	enum intr_level old_level = seqlock_write_lock (&ticks_seq);
+	bool tick = true;
+
+	/* A periodic tick that was already pending when the one-shot
+	   was armed leaves the one-shot alone. */
+	if (oneshot_expired ()) {
+		/* The one-shot ran out.  All but this tick went by idle,
+		   unless it was armed for a high-resolution timer that was
+		   due before the tick even ended. */
+		uint64_t clocks = tick_residue + oneshot_clocks;
+		int64_t skipped = clocks / tick_count;
+
+		tick_residue = clocks % tick_count;
+		oneshot_clocks = 0;
+		tick_set_periodic ();
+		if (skipped == 0)
+			tick = false;
+		else {
+			ticks += skipped - 1;
+			thread_account_idle (skipped - 1);
+		}
+	} else if (tsc_deadline_tick && oneshot_clocks == 0)
+		deadline_next_tick ();
+	if (tick)
+		ticks++;
+	seqlock_write_unlock (&ticks_seq, old_level);
+
+	if (tick) {
+		thread_tick ();
+		wheel_run (ticks);
+	}
+	hrtimer_run ();
+
+	/* The timers woke their threads without preempting; decide
+	   once for the whole batch. */
+	check_and_preempt ();
+}
+
+/* Puts T into the wheel slot that matches its expiry. */
+static void
+wheel_insert (struct timer *t) {
+	int64_t expires = t->expires;
+	int64_t idx = expires - wheel_ticks;
+	struct list *slot;
+	int level;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (idx < 0) {
+		/* Already due: fire on the next tick processed. */
+		slot = &tv1[wheel_ticks & TVR_MASK];
+	} else if (idx < TVR_SIZE) {
+		slot = &tv1[expires & TVR_MASK];
+	} else {
+		/* Timers beyond the wheel's range park in the last slot
+		   they can reach and are re-sorted when it cascades. */
+		if (idx > WHEEL_MAX_OFFSET)
+			expires = wheel_ticks + WHEEL_MAX_OFFSET;
+		idx = expires - wheel_ticks;
+		for (level = 0; level < TVN_LEVELS - 1; level++)
+			if (idx < 1LL << (TVR_BITS + (level + 1) * TVN_BITS))
+				break;
+		slot = &tvn[level][(expires >> (TVR_BITS + level * TVN_BITS))
+			& TVN_MASK];
+	}
+	list_push_back (slot, &t->elem);
+}
+
+/* Moves every timer in slot INDEX of coarse wheel LEVEL into the
+   finer wheels.  Returns INDEX, so that the caller can keep
+   cascading upward only when this level wraps too. */
+static int
+wheel_cascade (int level, int index) {
+	struct list *slot = &tvn[level][index];
+	struct list moved;
+
+	list_init (&moved);
+	while (!list_empty (slot))
+		list_push_back (&moved, list_pop_front (slot));
+	while (!list_empty (&moved))
+		wheel_insert (list_entry (list_pop_front (&moved), struct timer, elem));
+	return index;
+}
+
+/* Index of the slot in coarse wheel LEVEL for the current tick. */
+#define TVN_INDEX(LEVEL) \
+	((wheel_ticks >> (TVR_BITS + (LEVEL) * TVN_BITS)) & TVN_MASK)
+
+/* Fires every timer that has expired by tick NOW. */
+static void
+wheel_run (int64_t now) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (wheel_ticks <= now) {
+		int index = wheel_ticks & TVR_MASK;
+		struct list expired;
+		int level;
+
+		if (index == 0)
+			for (level = 0; level < TVN_LEVELS; level++)
+				if (wheel_cascade (level, TVN_INDEX (level)) != 0)
+					break;
+		wheel_ticks++;
+
+		/* Detach the slot first, since a timer function may
+		   re-arm its own timer into the slot just processed. */
+		list_init (&expired);
+		while (!list_empty (&tv1[index]))
+			list_push_back (&expired, list_pop_front (&tv1[index]));
+		while (!list_empty (&expired)) {
+			struct timer *t = list_entry (list_pop_front (&expired),
+					struct timer, elem);
+			t->pending = false;
+			t->func (t->aux);
+		}
+	}
+}
+
+/* Returns the tick at which the earliest pending timer fires, or
+   TICKS + LIMIT if none fires before that.  Only the next LIMIT
+   slots of the finest wheel are scanned, stopping early where
+   the wheel wraps, since coarser timers cascade in there. */
+static int64_t
+wheel_next_expiry (int64_t limit) {
+	int64_t t;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (t = wheel_ticks; t < ticks + limit; t++) {
+		if ((t & TVR_MASK) == 0 && t != wheel_ticks)
+			return t;
+		if (!list_empty (&tv1[t & TVR_MASK]))
+			return t;
+	}
+	return ticks + limit;
+}
+
+/* Puts the tick source in periodic mode, interrupting
+   TIMER_FREQ times per second. */
+static void
+tick_set_periodic (void) {
+	if (tsc_deadline_tick)
+		deadline_set_periodic ();
+	else if (lapic_tick)
+		lapic_timer_periodic (0x20, tick_count);
+	else
+		pit_set_periodic ();
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
+/* Programs the tick source to interrupt once, COUNT input clocks
+   from now. */
+static void
+tick_set_oneshot (uint32_t count) {
+	if (tsc_deadline_tick) {
+		tick_deadline = rdtsc () + count;
+		lapic_timer_deadline (tick_deadline);
+	} else if (lapic_tick)
+		lapic_timer_oneshot (0x20, count);
+	else
+		pit_set_oneshot (count);
+}
+
+/* Returns the current count of the tick source, which counts down
+   from the value it was last programmed with. */
+static uint32_t
+tick_read_count (void) {
+	if (tsc_deadline_tick)
+		return deadline_read_count ();
+	return lapic_tick ? lapic_timer_count () : pit_read_count ();
+}
+
+/* Switches the tick source to one-shot mode, or rearms it if it
+   already is in it, to interrupt CLOCKS input clocks from now.
+   The clocks that went by since the last tick, or since the
+   one-shot was armed, are kept in TICK_RESIDUE.  Must not be
+   called once a one-shot has run out. */
+static void
+oneshot_arm (uint64_t clocks) {
+	enum intr_level old_level;
+	uint32_t count;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (clocks > 0);
+
+	old_level = seqlock_write_lock (&ticks_seq);
+	count = tick_read_count ();
+	tick_residue += (oneshot_clocks > 0 ? oneshot_clocks : tick_count) - count;
+	oneshot_clocks = clocks;
+	tick_set_oneshot (clocks);
+	seqlock_write_unlock (&ticks_seq, old_level);
+}
+
+/* Returns true if the tick source is in one-shot mode and has
+   already counted down, so that its interrupt is pending. */
 static bool
-too_many_loops (unsigned loops) {
-	/* Wait for a timer tick. */
-	int64_t start = ticks;
-	while (ticks == start)
-		barrier ();
+oneshot_expired (void) {
+	uint32_t count;
 
-	/* Run LOOPS loops. */
-	start = ticks;
-	busy_wait (loops);
+	if (oneshot_clocks == 0)
+		return false;
 
-	/* If the tick count changed, we iterated too long. */
-	barrier ();
-	return start != ticks;
+	/* In mode 0 the PIT counter wraps around past zero. */
+	count = tick_read_count ();
+	return count == 0 || count > oneshot_clocks;
+}
+
+/* Returns the number of local APIC timer clocks in one tick,
+   timed against PIT counter 2 over 10 ms. */
+static unsigned
+lapic_calibrate (void) {
+	uint32_t left;
+
+	pit_gate_start (PIT_HZ / 100);
+	lapic_timer_oneshot (0, UINT32_MAX);
+	while (!pit_gate_done ())
+		continue;
+	left = lapic_timer_count ();
+	return ((uint64_t) (UINT32_MAX - left) * 100 + TIMER_FREQ / 2) / TIMER_FREQ;
+}
+
+/* Switches the local APIC timer from periodic mode to
+   TSC-deadline mode, converting the tick state to TSC cycles.
+   Called with interrupts off while the periodic tick runs. */
+static void
+tsc_deadline_start (void) {
+	enum intr_level old_level = seqlock_write_lock (&ticks_seq);
+	unsigned old_count = tick_count;
+
+	tick_count = (tsc_hz + TIMER_FREQ / 2) / TIMER_FREQ;
+	oneshot_max_ticks = UINT32_MAX / tick_count;
+	tick_residue = tick_residue * tick_count / old_count;
+	tsc_deadline_tick = true;
+	lapic_timer_deadline_mode (0x20);
+	tick_set_periodic ();
+	seqlock_write_unlock (&ticks_seq, old_level);
+}
+
+/* Arms the first periodic tick in TSC-deadline mode, one tick
+   from now. */
+static void
+deadline_set_periodic (void) {
+	tick_deadline = rdtsc () + tick_count;
+	lapic_timer_deadline (tick_deadline);
+}
+
+/* Arms the periodic tick that follows the one being handled, on
+   the next tick boundary after now.  Ticks the handler was too
+   late for are dropped, as a periodic counter would drop them. */
+static void
+deadline_next_tick (void) {
+	uint64_t now = rdtsc ();
+
+	if (now >= tick_deadline)
+		tick_deadline += ((now - tick_deadline) / tick_count + 1) * tick_count;
+	lapic_timer_deadline (tick_deadline);
+}
+
+/* Returns the TSC cycles left until the armed deadline.  Past a
+   periodic deadline whose interrupt is still pending, counts down
+   to the next boundary, as a periodic counter that reloaded
+   would; past a one-shot deadline, returns 0. */
+static uint32_t
+deadline_read_count (void) {
+	uint64_t now = rdtsc ();
+
+	if (now < tick_deadline)
+		return tick_deadline - now;
+	if (oneshot_clocks > 0)
+		return 0;
+	return tick_count - (now - tick_deadline) % tick_count;
+}
+
+/* Programs PIT counter 0 to interrupt TIMER_FREQ times per
+   second. */
+static void
+pit_set_periodic (void) {
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, PIT_TICK_COUNT & 0xff);
+	outb (0x40, PIT_TICK_COUNT >> 8);
+}
+
+/* Programs PIT counter 0 to interrupt once, COUNT input clocks
+   from now. */
+static void
+pit_set_oneshot (uint16_t count) {
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Latches and returns the current value of PIT counter 0. */
+static uint16_t
+pit_read_count (void) {
+	uint8_t lo, hi;
+
+	outb (0x43, 0x00);    /* CW: counter 0, latch. */
+	lo = inb (0x40);
+	hi = inb (0x40);
+	return lo | (hi << 8);
+}
+
+/* Starts PIT counter 2 counting down COUNT input clocks.  Its
+   output, which pit_gate_done() polls, needs no interrupts, and
+   the counter is otherwise unused: it only drives the PC
+   speaker, which is kept off. */
+static void
+pit_gate_start (uint16_t count) {
+	outb (0x61, (inb (0x61) & ~0x02) | 0x01);   /* Gate on, speaker off. */
+	outb (0x43, 0xb0);    /* CW: counter 2, LSB then MSB, mode 0, binary. */
+	outb (0x42, count & 0xff);
+	outb (0x42, count >> 8);
+}
+
+/* Returns true once PIT counter 2 has counted down to zero. */
+static bool
+pit_gate_done (void) {
+	return (inb (0x61) & 0x20) != 0;
+}
+
+/* Returns the number of whole ticks that have gone by since the
+   tick source was put in one-shot mode, adding left-over clocks to
+   and carrying whole ticks out of *RESIDUE.  If the one-shot has
+   already run out, counts every tick but the last, which its
+   pending interrupt will account. */
+static int64_t
+oneshot_elapsed (uint64_t *residue) {
+	uint32_t count;
+	int64_t elapsed;
+
+	ASSERT (oneshot_clocks > 0);
+
+	if (oneshot_expired ()) {
+		elapsed = (*residue + oneshot_clocks) / tick_count;
+		return elapsed > 0 ? elapsed - 1 : 0;
+	}
+
+	count = tick_read_count ();
+	*residue += oneshot_clocks - count;
+	elapsed = *residue / tick_count;
+	*residue %= tick_count;
+	return elapsed;
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+/* Returns true if high-resolution timer A expires before B. */
+static bool
+hrtimer_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct hrtimer *a = heap_entry (a_, struct hrtimer, elem);
+	const struct hrtimer *b = heap_entry (b_, struct hrtimer, elem);
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait (int64_t loops) {
-	while (loops-- > 0)
-		barrier ();
+	return a->expires < b->expires;
+}
+
+/* Returns true if the range of high-resolution timer A begins
+   before that of B. */
+static bool
+hrtimer_soft_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct hrtimer *a = heap_entry (a_, struct hrtimer, soft_elem);
+	const struct hrtimer *b = heap_entry (b_, struct hrtimer, soft_elem);
+
+	return a->soft_expires < b->soft_expires;
+}
+
+/* Fires every high-resolution timer whose range has begun, in
+   order of the start of their ranges, then arms the tick source
+   for the next deadline if it is due before the next tick. */
+static void
+hrtimer_run (void) {
+	uint64_t now = clock_now_ns ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (!heap_empty (&hrtimer_soft_queue)) {
+		struct hrtimer *t = heap_entry (heap_top (&hrtimer_soft_queue),
+				struct hrtimer, soft_elem);
+		if (t->soft_expires > now)
+			break;
+		heap_pop (&hrtimer_soft_queue);
+		heap_remove (&hrtimer_queue, &t->elem);
+		t->pending = false;
+		t->func (t->aux);
+	}
+	hrtimer_reprogram ();
+}
+
+/* If the earliest high-resolution timer is due before the tick
+   source would next interrupt anyway, rearms it in one-shot mode
+   to interrupt at that timer's deadline instead.  A one-shot that
+   has run out is left alone: its interrupt is pending and calls
+   back here. */
+static void
+hrtimer_reprogram (void) {
+	struct hrtimer *t;
+	uint64_t now, clocks;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (heap_empty (&hrtimer_queue) || oneshot_expired ())
+		return;
+
+	t = heap_entry (heap_top (&hrtimer_queue), struct hrtimer, elem);
+	now = clock_now_ns ();
+	clocks = t->expires > now ? t->expires - now : 0;
+	if (clocks >= NSEC_PER_TICK)
+		return;
+	clocks = clocks * tick_count / NSEC_PER_TICK + 1;
+	if (clocks < tick_read_count ())
+		oneshot_arm (clocks);
+}
+
+/* Blocks the current thread until clock_now_ns() reaches
+   DEADLINE, or up to SLACK nanoseconds later. */
+static void
+hrtimer_sleep (uint64_t deadline, uint64_t slack) {
+	struct hrtimer t;
+	enum intr_level old_level;
+
+	ASSERT (!intr_context ());
+
+	hrtimer_setup (&t, hrtimer_wakeup, thread_current ());
+	old_level = intr_disable ();
+	if (clock_now_ns () < deadline) {
+		hrtimer_add_range (&t, deadline, slack);
+		thread_block ();
+	}
+	intr_set_level (old_level);
+}
+
+/* Timer function for hrtimer_sleep(): wakes up the sleeping
+   thread T from the timer interrupt, which decides whether to
+   preempt. */
+static void
+hrtimer_wakeup (void *t) {
+	thread_unblock (t);
 }
 
 /* Sleep for approximately NUM/DENOM seconds. */
@@ -195,11 +997,17 @@ real_time_sleep (int64_t num, int32_t denom) {
 		   timer_sleep() because it will yield the CPU to other
 		   processes. */
 		timer_sleep (ticks);
-	} else {
-		/* Otherwise, use a busy-wait loop for more accurate
-		   sub-tick timing.  We scale the numerator and denominator
-		   down by 1000 to avoid the possibility of overflow. */
-		ASSERT (denom % 1000 == 0);
-		busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+	} else if (num > 0) {
+		/* Otherwise, time the sleep against the TSC.  NUM is less
+		   than DENOM here, so NUM * NSEC_PER_SEC cannot overflow. */
+		uint64_t ns = num * NSEC_PER_SEC / denom;
+		uint64_t deadline = clock_now_ns () + ns;
+
+		ASSERT (tsc_hz != 0);
+		if (ns >= SPIN_MAX_NS)
+			hrtimer_sleep (deadline, thread_current ()->timer_slack);
+		else
+			while (clock_now_ns () < deadline)
+				asm volatile ("pause");
 	}
 }
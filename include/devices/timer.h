@@ -1,23 +1,75 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <heap.h>
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* If true, the periodic tick is stopped while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
+/* Function called when a kernel timer expires.  It runs in the
+   timer interrupt handler, so it must not sleep. */
+typedef void timer_func (void *aux);
+
+/* A kernel timer.  Once armed with timer_add(), FUNC (AUX) is
+   called from the timer interrupt at the first tick at or after
+   EXPIRES, unless the timer is cancelled first. */
+struct timer {
+	struct list_elem elem;      /* Element in a timer wheel slot. */
+	int64_t expires;            /* Tick at which to fire. */
+	timer_func *func;           /* Function to call. */
+	void *aux;                  /* Argument to FUNC. */
+	bool pending;               /* Armed and not yet fired? */
+};
+
+/* A high-resolution timer.  Like struct timer, but it expires at
+   a clock_now_ns() time instead of a tick, so it is not limited
+   to the tick's resolution.  FUNC (AUX) runs in the timer
+   interrupt handler. */
+struct hrtimer {
+	struct heap_elem elem;      /* Element in the queue by EXPIRES. */
+	struct heap_elem soft_elem; /* Element in the queue by SOFT_EXPIRES. */
+	uint64_t soft_expires;      /* Earliest time at which it may fire. */
+	uint64_t expires;           /* Time by which it must fire. */
+	timer_func *func;           /* Function to call. */
+	void *aux;                  /* Argument to FUNC. */
+	bool pending;               /* Armed and not yet fired? */
+};
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
+int64_t timer_ticks_intr_off (void);
 int64_t timer_elapsed (int64_t);
+uint64_t clock_now_ns (void);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+void timer_setup (struct timer *, timer_func *, void *aux);
+void timer_add (struct timer *, int64_t expires);
+void timer_add_slack (struct timer *, int64_t expires, int64_t slack);
+bool timer_cancel (struct timer *);
+bool timer_pending (const struct timer *);
+
+void hrtimer_setup (struct hrtimer *, timer_func *, void *aux);
+void hrtimer_add (struct hrtimer *, uint64_t expires);
+void hrtimer_add_range (struct hrtimer *, uint64_t expires, uint64_t slack);
+bool hrtimer_cancel (struct hrtimer *);
+
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -0,0 +1,74 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue, implemented as a pairing heap.
+ *
+ * Like the doubly linked list in list.h, this heap does not
+ * require use of dynamically allocated memory.  Each structure
+ * that is a potential heap element must embed a struct
+ * heap_elem member, and heap_entry converts a struct heap_elem
+ * back to the structure that contains it.
+ *
+ * The heap keeps at its top the element that is "least"
+ * according to the heap_less_func given to heap_init().  Pass a
+ * "greater than" function to get a max-heap instead.
+ *
+ * Cost of the operations, for a heap of N elements:
+ *
+ * - heap_push(), heap_top(), heap_empty(), heap_size(): O(1).
+ *
+ * - heap_pop(), heap_remove(): O(log N) amortized.
+ *
+ * An element's ordering key must not change while it is in a
+ * heap.  To change it, heap_remove() the element, update the
+ * key, and heap_push() it again.
+ *
+ * Elements that compare equal come out in no particular order.
+ * If FIFO order among equals matters, break ties in the
+ * comparison function, for example with a sequence number. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem {
+	struct heap_elem *child;    /* First child. */
+	struct heap_elem *sibling;  /* Next sibling. */
+	struct heap_elem *prev;     /* Previous sibling, or parent. */
+};
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap {
+	struct heap_elem *root;     /* Top element, or null if empty. */
+	size_t size;                /* Number of elements. */
+	heap_less_func *less;       /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child    \
+		- offsetof (STRUCT, MEMBER.child)))
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+
+struct heap_elem *heap_top (const struct heap *);
+size_t heap_size (const struct heap *);
+bool heap_empty (const struct heap *);
+
+#endif /* lib/kernel/heap.h */
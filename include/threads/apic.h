@@ -0,0 +1,29 @@
+#ifndef THREADS_APIC_H
+#define THREADS_APIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Local APIC and I/O APIC.
+
+   With the APIC backend, the I/O APIC delivers ISA IRQ N to the
+   bootstrap processor as vector 0x20 + N, the same vectors the
+   8259 PIC uses, and every external interrupt is acknowledged
+   with a single write to the local APIC's EOI register: an MSR
+   write in x2APIC mode, a memory write otherwise. */
+
+/* Vector the local APIC uses for spurious interrupts. */
+#define APIC_SPURIOUS_VEC 0xff
+
+bool apic_init (void);
+void apic_eoi (void);
+void ioapic_mask_irq (int irq, bool masked);
+
+uint32_t lapic_timer_count (void);
+void lapic_timer_periodic (uint8_t vec, uint32_t count);
+void lapic_timer_oneshot (uint8_t vec, uint32_t count);
+bool lapic_has_tsc_deadline (void);
+void lapic_timer_deadline_mode (uint8_t vec);
+void lapic_timer_deadline (uint64_t tsc);
+
+#endif /* threads/apic.h */
@@ -0,0 +1,40 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Maximum number of CPUs the kernel keeps track of. */
+#define CPU_MAX 16
+
+/* A processor. */
+struct cpu {
+	unsigned id;                /* Index in cpus[]. */
+	uint8_t apic_id;            /* Local APIC ID. */
+	bool bsp;                   /* Bootstrap processor? */
+};
+
+/* The processors found by cpu_init().  cpus[0] is always the
+   bootstrap processor, the only one that runs the kernel. */
+extern struct cpu cpus[CPU_MAX];
+extern unsigned cpu_cnt;
+
+/* Physical addresses of the local APIC and of the first I/O
+   APIC, as reported by the firmware, or 0 if not known. */
+extern uint64_t lapic_phys_addr;
+extern uint64_t ioapic_phys_addr;
+extern uint8_t ioapic_id;
+
+/* I/O APIC input pin that each ISA IRQ is wired to, and its MP
+   table polarity and trigger flags (0 for the ISA defaults,
+   active high and edge triggered). */
+extern uint8_t isa_irq_pin[16];
+extern uint16_t isa_irq_flags[16];
+
+/* True if the firmware left the interrupt lines in PIC mode
+   behind the IMCR, so that they must be switched to the APIC. */
+extern bool mp_imcr;
+
+void cpu_init (void);
+
+#endif /* threads/cpu.h */
@@ -65,6 +65,10 @@ struct intr_frame {
 
 typedef void intr_handler_func (struct intr_frame *);
 
+/* If true, the local and I/O APIC handle interrupts instead of
+   the 8259 PIC. */
+extern bool intr_apic;
+
 void intr_init (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
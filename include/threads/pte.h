@@ -39,7 +39,14 @@
 #define PTE_P 0x1                        /* 1=present, 0=not present. */
 #define PTE_W 0x2                        /* 1=read/write, 0=read-only. */
 #define PTE_U 0x4                        /* 1=user/kernel, 0=kernel only. */
+#define PTE_PCD 0x10                     /* 1=cache disabled, for MMIO. */
 #define PTE_A 0x20                       /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40                       /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80                      /* 1=large page (PDEs and PDPEs only). */
+
+/* A PDE or PDPE with PTE_PS set maps a large page directly,
+   instead of pointing to the next level of page table. */
+#define LARGE_PGSIZE (1UL << PDXSHIFT)   /* Mapped by a PDE: 2 MB. */
+#define HUGE_PGSIZE (1UL << PDPESHIFT)   /* Mapped by a PDPE: 1 GB. */
 
 #endif /* threads/pte.h */
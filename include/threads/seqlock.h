@@ -0,0 +1,93 @@
+#ifndef THREADS_SEQLOCK_H
+#define THREADS_SEQLOCK_H
+
+#include <debug.h>
+#include <stdbool.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/* Sequence lock, for small pieces of data that are read far more
+   often than they are written, such as the tick counter.
+
+   A writer bumps SEQ to an odd value before it changes the data
+   and back to an even value afterward.  A reader samples SEQ with
+   seqlock_read_begin(), copies the data, and then asks
+   seqlock_read_retry() whether SEQ moved in the meantime; if it
+   did, the copy may be torn and the reader simply tries again.
+   Readers never block, never write shared memory, and never touch
+   the interrupt flag, so they are cheap enough to call in a tight
+   loop.
+
+   Writers exclude each other, and the readers on this CPU, by
+   turning interrupts off, which makes seqlock_write_lock() safe to
+   call from an interrupt handler.  Data guarded by a seqlock must
+   be plain values: a reader may see them half-updated before it
+   notices and retries, so it must not follow pointers out of
+   them.
+
+   Typical use:
+
+     unsigned seq;
+     do {
+       seq = seqlock_read_begin (&s);
+       copy = data;
+     } while (seqlock_read_retry (&s, seq)); */
+struct seqlock {
+	unsigned seq;               /* Odd while a write is in progress. */
+};
+
+/* Initializer for a seqlock with static storage duration. */
+#define SEQLOCK_INITIALIZER { 0 }
+
+/* Initializes S. */
+static inline void
+seqlock_init (struct seqlock *s) {
+	s->seq = 0;
+}
+
+/* Starts a read-side critical section on S and returns the
+   sequence number to pass to seqlock_read_retry().  Waits out a
+   write in progress on another CPU; on this CPU none can be, since
+   writers run with interrupts off. */
+static inline unsigned
+seqlock_read_begin (const struct seqlock *s) {
+	unsigned seq;
+
+	while ((seq = *(const volatile unsigned *) &s->seq) & 1)
+		asm volatile ("pause");
+	barrier ();
+	return seq;
+}
+
+/* Ends a read-side critical section on S that began with sequence
+   number START.  Returns true if a writer got in meanwhile, in
+   which case the data read must be discarded and read again. */
+static inline bool
+seqlock_read_retry (const struct seqlock *s, unsigned start) {
+	barrier ();
+	return *(const volatile unsigned *) &s->seq != start;
+}
+
+/* Starts a write to the data guarded by S.  Turns interrupts off
+   and returns the previous interrupt level, to be handed back to
+   seqlock_write_unlock(). */
+static inline enum intr_level
+seqlock_write_lock (struct seqlock *s) {
+	enum intr_level old_level = intr_disable ();
+
+	ASSERT ((s->seq & 1) == 0);
+	s->seq++;
+	barrier ();
+	return old_level;
+}
+
+/* Ends a write to the data guarded by S and restores the interrupt
+   level OLD_LEVEL returned by seqlock_write_lock(). */
+static inline void
+seqlock_write_unlock (struct seqlock *s, enum intr_level old_level) {
+	barrier ();
+	s->seq++;
+	intr_set_level (old_level);
+}
+
+#endif /* threads/seqlock.h */
@@ -0,0 +1,44 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Object caches, after Bonwick's slab allocator.
+
+   malloc() rounds every request up to a power of two, so a
+   552-byte struct inode takes a 1024-byte block.  A kmem_cache
+   instead hands out objects of one fixed size, carved from
+   one-page "slabs" with no per-object header, and keeps its own
+   lock, so that callers of different caches do not contend.
+
+   Each cache keeps its slabs on three lists: partial slabs,
+   which are used first, full slabs, and empty slabs, a few of
+   which are kept so that a cache going back and forth across a
+   slab boundary does not hit the page allocator every time.
+   Successive slabs start their objects at different offsets
+   ("colors") within the page, using up the slack at the end of
+   the page, so that the same object in different slabs does not
+   always map to the same cache lines.
+
+   If a cache has a constructor, it runs once for each object
+   when its slab is created, not on every kmem_cache_alloc().
+   Objects must be given back to kmem_cache_free() in their
+   constructed state, so that state that is expensive to set up,
+   such as an initialized lock or list, survives reuse.  A
+   constructor must not allocate from its own cache. */
+
+/* Object constructor. */
+typedef void kmem_ctor_func (void *obj);
+
+struct kmem_cache;
+
+void slab_init (void);
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+
+void kmem_cache_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -1,36 +1,76 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
 
+struct thread;
+
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
 	
-	// 이 waiters에는 이 semaphore에 관련하여 잠자고 있는 스레드 (struct thread의 elem 멤버)이 저장됨
-	struct list waiters;        /* List of waiting threads. */
+	// 이 waiters에는 이 semaphore에 관련하여 잠자고 있는 스레드 (struct thread의 wait_elem 멤버)이 저장됨
+	// priority가 가장 높은 (같으면 먼저 온) 스레드가 heap의 top.
+	struct heap waiters;        /* Waiting threads, highest priority first. */
 	
 };
+
+/* A thread's hold on a lock or reader-writer lock, through which
+   the threads waiting for the lock donate priority. */
+// holder의 held_locks heap에서 쓰임. priority는 이 락을 기다리는 스레드 중 최고 priority (= holder에게 기부하는 값).
+struct lock_hold {
+	int priority;               /* Priority donated through this hold. */
+	struct heap_elem elem;      /* Element in holder's held_locks. */
+};
+
 /* Lock. */
 struct lock {
-	struct thread *holder;      /* Thread holding lock (for debugging). */
-	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct thread *holder;      /* Thread holding lock; set by compare-and-swap. */
+	struct semaphore semaphore; /* Threads waiting (value stays 0). */
+	struct lock_hold hold;      /* Donation to HOLDER. */
+};
+
+/* Reader-writer lock.  Any number of readers, or a single writer,
+   may hold it at once.  Writers are preferred: once a writer
+   waits, new readers wait behind it, so readers cannot starve
+   writers. */
+struct rwlock {
+	struct thread *writer;      /* Thread holding it for writing. */
+	unsigned readers;           /* # of threads holding it for reading. */
+	unsigned writers_waiting;   /* # of threads trying to write. */
+	struct semaphore read_sema; /* Readers waiting (value stays 0). */
+	struct semaphore write_sema;/* Writers waiting (value stays 0). */
+	struct lock_hold write_hold;/* Donation to WRITER. */
+	struct list read_holds;     /* Donations to readers (rw_read_hold). */
+};
+
+/* A thread's hold on a reader-writer lock for reading.  Each
+   thread has RW_READ_HOLD_MAX of these in its struct thread. */
+#define RW_READ_HOLD_MAX 4
+struct rw_read_hold {
+	struct rwlock *rwlock;      /* Lock held for reading, or null. */
+	struct thread *holder;      /* Thread that owns this hold. */
+	struct lock_hold hold;      /* Donation to HOLDER. */
+	struct list_elem elem;      /* Element in rwlock's read_holds. */
 };
 
 /* Condition variable. */
 // 각 공유 자원마다 하나씩 가짐. 공유 자원별로 따로따로 하나씩 갖고 있어야 함.
 struct condition {
 	// 이 waiters에는 조건이 충족될 때까지 기다리는 세마포어들이 저장됨.
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, highest priority first. */
 };
 
 /* 참고용: synch.c의 semaphore_elem
 // 현재 스레드가 사용할 "자기 전용 이진 세마포어".
 struct semaphore_elem {
-	// 참고: elem의 멤버는 struct list_elem *prev, *next;
-	struct list_elem elem;      
-	struct semaphore semaphore; 
+	struct heap_elem elem;
+	struct semaphore semaphore;
+	struct thread *thread;
+	int priority;
+	unsigned long long seq;
 };
 */
 
@@ -39,6 +79,7 @@ void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
+void sema_waiter_set_priority (struct thread *, int priority);
 
 void lock_init (struct lock *);
 void lock_acquire (struct lock *);
@@ -46,17 +87,19 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+void rw_init (struct rwlock *);
+void rw_read_acquire (struct rwlock *);
+void rw_read_release (struct rwlock *);
+void rw_write_acquire (struct rwlock *);
+void rw_write_release (struct rwlock *);
+bool rw_read_held_by_current_thread (const struct rwlock *);
+bool rw_write_held_by_current_thread (const struct rwlock *);
+
 void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
-/*-- Priority condvar 구현 --*/
-bool sema_priority_cmp(const struct list_elem *a, const struct list_elem *b, void *aux );
-bool donation_priority_cmp(const struct list_elem *a,
-						   const struct list_elem *b, void *aux);
-/*-- Priority condvar 구현 --*/
-
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -2,9 +2,13 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
+#include "devices/timer.h"
+#include "threads/fixed-point.h"
 #include "threads/interrupt.h"
+#include "threads/synch.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -28,6 +32,20 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the multi-level feedback queue scheduler. */
+#define NICE_MIN -20                    /* Nicest. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
+/* Thread tickets, for the stride scheduler. */
+#define TICKETS_MIN 1                   /* Smallest share. */
+#define TICKETS_DEFAULT 100             /* Default share. */
+#define TICKETS_MAX 1000                /* Largest share. */
+
+/* Default timer slack, in nanoseconds.  Well under one tick, so by
+   default only sub-tick sleeps are coalesced. */
+#define TIMER_SLACK_DEFAULT 50000
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -91,9 +109,16 @@ struct thread {
 	enum thread_status status;          /* Thread state. */
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
+	struct list_elem tid_elem;          /* Element in the tid table. */
+	int preempt_count;                  /* preempt_disable() nesting depth. */
+	bool need_resched;                  /* Preempted while preemption was off? */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
+	struct heap_elem wait_elem;         /* Semaphore waiters element. */
+	struct semaphore *wait_sema;        /* Semaphore blocked on, if any. */
+	struct condition *wait_cond;        /* Condition waited on, if any. */
+	unsigned long long wait_seq;        /* Keeps equal waiters in FIFO order. */
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
@@ -106,18 +131,51 @@ struct thread {
 
 	/* Owned by thread.c. */
 	struct intr_frame tf;               /* Information for switching */
+	uint64_t switch_rsp;                /* Saved stack pointer, or 0 to start from tf. */
 	unsigned magic;                     /* Detects stack overflow. */
     
 	/*-- Alarm clock 과제  --*/
-	int64_t wakeup_tick; // Alarm clock 과제 - 어느 틱에 깨울지.
+	struct timer sleep_timer; // Alarm clock 과제 - 어느 틱에 깨울지 (timer wheel에 등록).
+	int64_t timer_slack;                /* How late sleeps may end, in ns. */
 	/*-- Alarm clock 과제  --*/
 
 	/*-- Priority donation 과제 --*/
-	int original_priority;
-    struct lock *wait_lock;
-    struct list donations;
-    struct list_elem donation_elem;
+	int original_priority;              /* Priority before donations. */
+	struct lock *wait_lock;             /* Lock being acquired, if any. */
+	struct rwlock *wait_rwlock;         /* RW lock being acquired, if any. */
+	struct heap held_locks;             /* Holds, by donated priority. */
+	struct rw_read_hold read_holds[RW_READ_HOLD_MAX]; /* RW locks read. */
 	/*-- Priority donation 과제 --*/
+
+	/*-- Advanced scheduler (MLFQS) 과제 --*/
+	int nice;                           /* Niceness. */
+	fixed_t recent_cpu;                 /* Recent CPU time received. */
+	int64_t recent_cpu_sec;             /* Second RECENT_CPU is up to date for. */
+	bool mlfqs_dirty;                   /* On the MLFQS dirty list? */
+	struct list_elem dirty_elem;        /* MLFQS dirty list element. */
+	/*-- Advanced scheduler (MLFQS) 과제 --*/
+
+	/* Owned by thread.c, for the stride scheduler. */
+	int tickets;                        /* Share of the CPU. */
+	int64_t stride;                     /* STRIDE1 / tickets. */
+	int64_t pass;                       /* Virtual time of next quantum. */
+	struct heap_elem stride_elem;       /* Stride run queue element. */
+
+	/* Owned by thread.c, for real-time (EDF) threads. */
+	bool rt;                            /* Real-time thread? */
+	int64_t rt_period;                  /* Period, in timer ticks. */
+	int64_t rt_budget;                  /* CPU ticks allowed per period. */
+	int64_t rt_deadline;                /* End of the current period. */
+	int64_t rt_remaining;               /* Budget left in this period. */
+	bool rt_throttled;                  /* Out of budget until next period? */
+	bool rt_waiting;                    /* In thread_rt_wait_period()? */
+	int rt_misses;                      /* # of missed deadlines. */
+	struct timer rt_timer;              /* Fires at each period boundary. */
+	struct heap_elem rt_elem;           /* EDF run queue element. */
+	struct list_elem rt_list_elem;      /* Element in list of RT threads. */
+
+	/* Owned by threads/malloc.c. */
+	struct magazines *magazines;        /* Free block caches, or null. */
 };
 
 /* If false (default), use round-robin scheduler.
@@ -125,26 +183,49 @@ struct thread {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the stride scheduler, which hands out CPU time in
+   proportion to each thread's tickets.
+   Controlled by kernel command-line option "-stride". */
+extern bool thread_stride;
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_account_idle (int64_t ticks);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+tid_t thread_create_rt (const char *name, int64_t period, int64_t budget,
+		thread_func *, void *);
+void thread_rt_wait_period (void);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
+struct thread *thread_find (tid_t);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
-
-bool thread_priority_cmp(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
+void thread_sleep (int64_t end_tick);
+void check_and_preempt (void);
+void thread_preempt (void);
+
+void preempt_disable (void);
+void preempt_enable (void);
+bool preempt_disabled (void);
+
+void donate_priority (struct lock *);
+void donate_priority_from (struct thread *);
+void add_held_lock (struct lock *);
+void remove_held_lock (struct lock *);
+void add_held_rwlock (struct rwlock *, bool writing);
+void remove_held_rwlock (struct rwlock *, bool writing);
+void refresh_priority (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
@@ -154,6 +235,12 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
+int thread_get_tickets (void);
+void thread_set_tickets (int);
+
+int64_t thread_get_timer_slack (void);
+void thread_set_timer_slack (int64_t);
+
 void do_iret (struct intr_frame *tf);
 
 #endif /* threads/thread.h */
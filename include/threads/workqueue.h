@@ -0,0 +1,58 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+
+/* Deferred work, or "bottom halves".
+
+   An interrupt handler runs with interrupts off and must not
+   sleep, so it should do only what cannot wait, such as
+   acknowledging the device or draining its buffer, and leave the
+   rest to a kernel worker thread, which runs it with interrupts
+   on like any other thread.
+
+   work_queue() queues a call FUNC (AUX) to run once in a worker
+   thread.  There is one worker per work_prio, each running its
+   queue in FIFO order.  Queueing takes no memory allocation, so
+   it is safe from an interrupt handler, but the queues have a
+   fixed size and work_queue() returns false when one is full.
+
+   A tasklet is a work item that the caller owns.  It cannot fail
+   to queue, and scheduling it again before it has run does not
+   queue it twice, which suits "there is more to do"
+   notifications.  Tasklets run in the WORK_HIGH worker, ahead of
+   its queued work.
+
+   Work functions may sleep and take locks.  Like interrupt
+   handlers, they should not sleep for long, since they hold up
+   everything queued behind them. */
+
+/* Deferred work function. */
+typedef void work_func (void *aux);
+
+/* Worker priorities. */
+enum work_prio {
+	WORK_HIGH,                  /* Runs at PRI_MAX. */
+	WORK_NORMAL,                /* Runs at PRI_DEFAULT. */
+	WORK_LOW,                   /* Runs at PRI_MIN. */
+	WORK_PRIO_CNT
+};
+
+/* A tasklet. */
+struct tasklet {
+	struct list_elem elem;      /* Element in the tasklet list. */
+	work_func *func;            /* Function to call. */
+	void *aux;                  /* Argument to FUNC. */
+	bool scheduled;             /* Scheduled and not yet started? */
+};
+
+void workqueue_init (void);
+
+bool work_queue (work_func *, void *aux);
+bool work_queue_prio (enum work_prio, work_func *, void *aux);
+
+void tasklet_init (struct tasklet *, work_func *, void *aux);
+void tasklet_schedule (struct tasklet *);
+
+#endif /* threads/workqueue.h */
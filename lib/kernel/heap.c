@@ -0,0 +1,177 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a heap-ordered multiway tree.  Each node
+   points to its first child and to its next sibling, and back
+   to its previous sibling, or to its parent if it is a first
+   child, so that any node can be unlinked in O(1).
+
+   Two heaps are melded by making the root with the larger key
+   the first child of the other root.  Pushing melds a
+   one-element heap into the root.  Popping the root merges its
+   children pairwise from left to right, then melds the pairs
+   together from right to left; this "two-pass" merge is what
+   gives the O(log n) amortized bound.  Both passes are done
+   iteratively, so the kernel stack never grows with the size of
+   the heap. */
+
+static struct heap_elem *meld (struct heap *,
+		struct heap_elem *a, struct heap_elem *b);
+static struct heap_elem *merge_pairs (struct heap *,
+		struct heap_elem *first);
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux) {
+	ASSERT (heap != NULL);
+	ASSERT (less != NULL);
+
+	heap->root = NULL;
+	heap->size = 0;
+	heap->less = less;
+	heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	elem->child = elem->sibling = elem->prev = NULL;
+	heap->root = meld (heap, heap->root, elem);
+	heap->size++;
+}
+
+/* Removes the top element of HEAP and returns it.  Undefined
+   behavior if HEAP is empty before removal. */
+struct heap_elem *
+heap_pop (struct heap *heap) {
+	struct heap_elem *top;
+
+	ASSERT (heap != NULL);
+	ASSERT (heap->root != NULL);
+
+	top = heap->root;
+	heap->root = merge_pairs (heap, top->child);
+	heap->size--;
+	return top;
+}
+
+/* Removes ELEM, which must be in HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem) {
+	struct heap_elem *subtree;
+
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	if (elem == heap->root) {
+		heap_pop (heap);
+		return;
+	}
+
+	/* Unlink ELEM, with its children, from its parent or its
+	   previous sibling. */
+	ASSERT (elem->prev != NULL);
+	if (elem->prev->child == elem)
+		elem->prev->child = elem->sibling;
+	else
+		elem->prev->sibling = elem->sibling;
+	if (elem->sibling != NULL)
+		elem->sibling->prev = elem->prev;
+
+	/* Put its children back. */
+	subtree = merge_pairs (heap, elem->child);
+	heap->root = meld (heap, heap->root, subtree);
+	heap->size--;
+}
+
+/* Returns the top element of HEAP, or a null pointer if HEAP is
+   empty. */
+struct heap_elem *
+heap_top (const struct heap *heap) {
+	ASSERT (heap != NULL);
+
+	return heap->root;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (const struct heap *heap) {
+	ASSERT (heap != NULL);
+
+	return heap->size;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap) {
+	ASSERT (heap != NULL);
+
+	return heap->root == NULL;
+}
+
+/* Melds the trees rooted at A and B, neither of which may have
+   siblings, and returns the root of the result.  Either may be
+   null.  On a tie A stays on top. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b) {
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+
+	if (heap->less (b, a, heap->aux)) {
+		struct heap_elem *tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	/* Make B the first child of A. */
+	b->prev = a;
+	b->sibling = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	a->prev = a->sibling = NULL;
+	return a;
+}
+
+/* Merges the sibling list that starts at FIRST into a single
+   tree and returns its root, or a null pointer if FIRST is
+   null. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;
+	struct heap_elem *root = NULL;
+
+	/* First pass, left to right: meld adjacent pairs, stacking
+	   the results on PAIRS through their sibling links. */
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->sibling;
+		struct heap_elem *next = b != NULL ? b->sibling : NULL;
+
+		a->prev = a->sibling = NULL;
+		if (b != NULL) {
+			b->prev = b->sibling = NULL;
+			a = meld (heap, a, b);
+		}
+		a->sibling = pairs;
+		pairs = a;
+		first = next;
+	}
+
+	/* Second pass, right to left: meld each pair into the
+	   accumulated result. */
+	while (pairs != NULL) {
+		struct heap_elem *next = pairs->sibling;
+
+		pairs->sibling = NULL;
+		root = meld (heap, root, pairs);
+		pairs = next;
+	}
+	return root;
+}
@@ -0,0 +1,69 @@
+/* Creates THREAD_CNT threads that sleep until consecutive ticks,
+   all with enough timer slack to cover the spread, and checks
+   that they were woken together, on a single tick, and that none
+   woke before its deadline. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 4
+#define SLACK_TICKS 16
+
+struct sleeper 
+  {
+    int64_t deadline;           /* Tick to sleep until. */
+    int64_t woke;               /* Tick it actually woke on. */
+  };
+
+static thread_func sleeper_func;
+
+void
+test_alarm_slack (void) 
+{
+  struct sleeper sleepers[THREAD_CNT];
+  int64_t base;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Start on a multiple of twice the slack, so that the slack
+     rounds every deadline up to the same tick. */
+  thread_set_timer_slack (SLACK_TICKS * (1000000000LL / TIMER_FREQ));
+  base = (timer_ticks () / (2 * SLACK_TICKS) + 2) * (2 * SLACK_TICKS);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "sleeper %d", i);
+      sleepers[i].deadline = base + 1 + i;
+      sleepers[i].woke = -1;
+      thread_create (name, PRI_DEFAULT, sleeper_func, &sleepers[i]);
+    }
+
+  timer_sleep (base + 2 * SLACK_TICKS - timer_ticks ());
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      if (sleepers[i].woke < sleepers[i].deadline)
+        fail ("sleeper %d woke on tick %lld, before its deadline %lld",
+              i, sleepers[i].woke, sleepers[i].deadline);
+      if (sleepers[i].woke != sleepers[0].woke)
+        fail ("sleeper %d woke on tick %lld, sleeper 0 on %lld",
+              i, sleepers[i].woke, sleepers[0].woke);
+    }
+  msg ("All %d sleepers woke on one tick.", THREAD_CNT);
+  msg ("None woke early.");
+}
+
+static void
+sleeper_func (void *s_) 
+{
+  struct sleeper *s = s_;
+
+  timer_sleep (s->deadline - timer_ticks ());
+  s->woke = timer_ticks ();
+}
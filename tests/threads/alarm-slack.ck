@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-slack) begin
+(alarm-slack) All 4 sleepers woke on one tick.
+(alarm-slack) None woke early.
+(alarm-slack) end
+EOF
+pass;
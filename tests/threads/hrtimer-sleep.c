@@ -0,0 +1,72 @@
+/* Checks that sub-tick sleeps block instead of spinning.
+
+   The main thread sleeps for SLEEP_US microseconds, well under
+   one timer tick, SLEEP_CNT times in a row, while a
+   lower-priority thread spins counting loop iterations.  Since
+   the low-priority thread can only run while the main thread is
+   blocked, it gets to count only if the sleeps really gave up
+   the CPU.  Each sleep must also last at least as long as
+   requested, as measured by clock_now_ns(). */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEP_US 500
+#define SLEEP_CNT 20
+
+struct spinner 
+  {
+    struct semaphore done;
+    volatile bool stop;
+    volatile long long loops;
+  };
+
+static thread_func spinner_func;
+
+void
+test_hrtimer_sleep (void) 
+{
+  struct spinner s;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&s.done, 0);
+  s.stop = false;
+  s.loops = 0;
+  thread_create ("spinner", PRI_MIN, spinner_func, &s);
+
+  for (i = 0; i < SLEEP_CNT; i++)
+    {
+      uint64_t start = clock_now_ns ();
+      uint64_t slept;
+
+      timer_usleep (SLEEP_US);
+      slept = clock_now_ns () - start;
+      if (slept < SLEEP_US * 1000ULL)
+        fail ("sleep %d lasted only %llu ns", i,
+              (unsigned long long) slept);
+    }
+  msg ("Slept %d times for %d us each.", SLEEP_CNT, SLEEP_US);
+
+  s.stop = true;
+  sema_down (&s.done);
+  if (s.loops == 0)
+    fail ("spinner never ran while the main thread slept");
+  msg ("Spinner ran while the main thread slept.");
+}
+
+static void
+spinner_func (void *s_) 
+{
+  struct spinner *s = s_;
+
+  while (!s->stop)
+    s->loops++;
+  sema_up (&s->done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(hrtimer-sleep) begin
+(hrtimer-sleep) Slept 20 times for 500 us each.
+(hrtimer-sleep) Spinner ran while the main thread slept.
+(hrtimer-sleep) end
+EOF
+pass;
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# The reader-writer lock must complete at least twice as many
+# lookups as the plain lock.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (%lookups);
+foreach (@output) {
+    my ($kind, $count) = /(rwlock|lock): (\d+) lookups/ or next;
+    $lookups{$kind} = $count;
+}
+fail "Missing lookup counts.\n"
+  if !defined $lookups{lock} || !defined $lookups{rwlock};
+fail "Plain lock completed no lookups.\n" if $lookups{lock} == 0;
+fail "rwlock completed $lookups{rwlock} lookups, "
+  . "less than twice the $lookups{lock} of the plain lock.\n"
+  if $lookups{rwlock} < 2 * $lookups{lock};
+pass;
@@ -0,0 +1,85 @@
+/* The main thread and a second thread, "reader2", hold a
+   reader-writer lock for reading.  A higher-priority writer then
+   blocks on the lock, which must donate its priority to both
+   readers.  A reader that arrives after the writer must wait
+   behind it, even though the lock is held only for reading.
+   Once both readers release the lock, the writer should get it
+   first, then the waiting reader. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct rwlock_donate_data 
+  {
+    struct rwlock rwlock;
+    struct semaphore sema;
+  };
+
+static thread_func reader2_thread_func;
+static thread_func reader3_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_donate (void) 
+{
+  struct rwlock_donate_data data;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rw_init (&data.rwlock);
+  sema_init (&data.sema, 0);
+  rw_read_acquire (&data.rwlock);
+  thread_create ("reader2", PRI_DEFAULT + 1, reader2_thread_func, &data);
+  thread_create ("writer", PRI_DEFAULT + 4, writer_thread_func, &data);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 4, thread_get_priority ());
+  thread_create ("reader3", PRI_DEFAULT + 3, reader3_thread_func, &data);
+  rw_read_release (&data.rwlock);
+  sema_up (&data.sema);
+  msg ("writer, reader3, reader2 must already have finished, in that order.");
+  msg ("This should be the last line before finishing this test.");
+}
+
+static void
+reader2_thread_func (void *data_) 
+{
+  struct rwlock_donate_data *data = data_;
+
+  rw_read_acquire (&data->rwlock);
+  msg ("reader2: got the lock");
+  sema_down (&data->sema);
+  msg ("reader2 should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 4, thread_get_priority ());
+  rw_read_release (&data->rwlock);
+  msg ("reader2: done");
+}
+
+static void
+reader3_thread_func (void *data_) 
+{
+  struct rwlock_donate_data *data = data_;
+
+  msg ("reader3: waiting behind the writer");
+  rw_read_acquire (&data->rwlock);
+  msg ("reader3: got the lock");
+  rw_read_release (&data->rwlock);
+  msg ("reader3: done");
+}
+
+static void
+writer_thread_func (void *data_) 
+{
+  struct rwlock_donate_data *data = data_;
+
+  rw_write_acquire (&data->rwlock);
+  msg ("writer: got the lock");
+  rw_write_release (&data->rwlock);
+  msg ("writer: done");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-donate) begin
+(rwlock-donate) reader2: got the lock
+(rwlock-donate) This thread should have priority 35.  Actual priority: 35.
+(rwlock-donate) reader3: waiting behind the writer
+(rwlock-donate) reader2 should have priority 35.  Actual priority: 35.
+(rwlock-donate) writer: got the lock
+(rwlock-donate) writer: done
+(rwlock-donate) reader3: got the lock
+(rwlock-donate) reader3: done
+(rwlock-donate) reader2: done
+(rwlock-donate) writer, reader3, reader2 must already have finished, in that order.
+(rwlock-donate) This should be the last line before finishing this test.
+(rwlock-donate) end
+EOF
+pass;
@@ -0,0 +1,113 @@
+/* Runs readers and writers of several priorities against one
+   reader-writer lock, with every thread yielding inside its
+   critical section so that they interleave as much as possible.
+   Checks that a writer never overlaps with any other holder, that
+   readers never see a half-written table, and that every thread
+   finishes, i.e. that neither readers nor writers starve. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define READER_CNT 8
+#define WRITER_CNT 3
+#define ITER_CNT 200
+#define TABLE_SIZE 16
+
+static struct rwlock rwlock;
+static struct semaphore done;
+static int table[TABLE_SIZE];
+static int active_readers;
+static int active_writers;
+static int max_readers;
+static int reads;
+static int writes;
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_stress (void) 
+{
+  int i;
+
+  rw_init (&rwlock);
+  sema_init (&done, 0);
+
+  for (i = 0; i < READER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT - i % 3, reader_thread_func, NULL);
+    }
+  for (i = 0; i < WRITER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "writer %d", i);
+      thread_create (name, PRI_DEFAULT - 1 + i, writer_thread_func, NULL);
+    }
+
+  thread_set_priority (PRI_MIN);
+  for (i = 0; i < READER_CNT + WRITER_CNT; i++)
+    sema_down (&done);
+
+  msg ("%d reads and %d writes completed.", reads, writes);
+  if (max_readers < 2)
+    fail ("readers never held the lock together");
+  msg ("Readers shared the lock.");
+}
+
+static void
+reader_thread_func (void *aux UNUSED) 
+{
+  int i, j;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      rw_read_acquire (&rwlock);
+      if (active_writers != 0)
+        fail ("reader overlapped with a writer");
+      if (++active_readers > max_readers)
+        max_readers = active_readers;
+
+      thread_yield ();
+      for (j = 1; j < TABLE_SIZE; j++)
+        if (table[j] != table[0])
+          fail ("reader saw a half-written table");
+
+      active_readers--;
+      reads++;
+      rw_read_release (&rwlock);
+      thread_yield ();
+    }
+  sema_up (&done);
+}
+
+static void
+writer_thread_func (void *aux UNUSED) 
+{
+  int i, j;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      rw_write_acquire (&rwlock);
+      if (active_writers != 0 || active_readers != 0)
+        fail ("writer overlapped with another holder");
+      active_writers++;
+
+      for (j = 0; j < TABLE_SIZE; j++)
+        {
+          table[j]++;
+          if (j == TABLE_SIZE / 2)
+            thread_yield ();
+        }
+
+      active_writers--;
+      writes++;
+      rw_write_release (&rwlock);
+      thread_yield ();
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-stress) begin
+(rwlock-stress) 1600 reads and 600 writes completed.
+(rwlock-stress) Readers shared the lock.
+(rwlock-stress) end
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Measures the cost of reading the tick counter.
+
+   timer_ticks() reads the tick counter under a seqlock, without
+   touching the interrupt flag.  The test first counts how many
+   times it can call timer_ticks() in RUN_TICKS ticks, then how
+   many times it can call timer_ticks_intr_off(), which reads the
+   counter the old way, with interrupts turned off around a plain
+   load and no seqlock.  Along the way it checks that the tick
+   count never goes backward, which a torn read of the 64-bit
+   counter could make it do.
+
+   seqlock-bench.ck only checks that both counts are there and
+   reports their ratio, since which read is cheaper depends on how
+   the emulator prices cli and sti. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "devices/timer.h"
+
+#define RUN_TICKS (2 * TIMER_FREQ)
+
+static long long count_reads (int64_t (*read) (void));
+
+void
+test_seqlock_bench (void) 
+{
+  long long seqlock_reads, locked_reads;
+
+  seqlock_reads = count_reads (timer_ticks);
+  locked_reads = count_reads (timer_ticks_intr_off);
+
+  msg ("seqlock: %lld reads in %d ticks.", seqlock_reads, RUN_TICKS);
+  msg ("intr_disable: %lld reads in %d ticks.", locked_reads, RUN_TICKS);
+}
+
+/* Returns the number of calls to READ made in RUN_TICKS ticks,
+   starting at a tick boundary. */
+static long long
+count_reads (int64_t (*read) (void)) 
+{
+  int64_t start, end, prev, now;
+  long long reads = 0;
+
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  end = start + 1 + RUN_TICKS;
+
+  prev = read ();
+  do
+    {
+      now = read ();
+      if (now < prev)
+        fail ("tick count went back from %"PRId64" to %"PRId64,
+              prev, now);
+      prev = now;
+      reads++;
+    }
+  while (now < end);
+  return reads;
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# Both ways of reading the tick counter must complete some reads.
+# Which one is faster depends on how the emulator prices cli and
+# sti, so the ratio is only reported, not checked.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (%reads);
+foreach (@output) {
+    my ($kind, $count) = /(seqlock|intr_disable): (\d+) reads/ or next;
+    $reads{$kind} = $count;
+}
+fail "Missing read counts.\n"
+  if !defined $reads{seqlock} || !defined $reads{intr_disable};
+fail "No reads under the seqlock.\n" if $reads{seqlock} == 0;
+fail "No reads with interrupts off.\n" if $reads{intr_disable} == 0;
+pass sprintf ("seqlock/intr_disable read ratio: %.2f",
+              $reads{seqlock} / $reads{intr_disable});
@@ -0,0 +1,102 @@
+/* Allocates OBJ_CNT objects from a new object cache, enough to
+   fill several slabs, and checks that they do not overlap, that
+   the constructor ran once per object rather than once per
+   allocation, that freed objects keep their constructed state,
+   and that different slabs start their objects at different
+   colors. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+#define OBJ_CNT 64
+#define OBJ_MAGIC 0x0b1ec7
+
+struct obj
+  {
+    int magic;
+    int id;
+    char pad[192];
+  };
+
+static int ctor_cnt;
+
+static kmem_ctor_func obj_ctor;
+
+void
+test_slab_cache (void) 
+{
+  struct kmem_cache *cache;
+  struct obj *objs[OBJ_CNT];
+  size_t colors[OBJ_CNT];
+  size_t color_cnt = 0;
+  int first_ctor_cnt;
+  int i, j;
+
+  cache = kmem_cache_create ("test", sizeof (struct obj), obj_ctor);
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i] = kmem_cache_alloc (cache);
+      if (objs[i] == NULL)
+        fail ("allocation %d failed", i);
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %d was not constructed", i);
+      for (j = 0; j < i; j++)
+        if ((uint8_t *) objs[i] < (uint8_t *) objs[j] + sizeof (struct obj)
+            && (uint8_t *) objs[j] < (uint8_t *) objs[i] + sizeof (struct obj))
+          fail ("objects %d and %d overlap", j, i);
+      objs[i]->id = i;
+    }
+  msg ("Allocated %d objects.", OBJ_CNT);
+
+  /* Objects in one slab share a position modulo the object size;
+     a different color shifts it. */
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      size_t color = pg_ofs (objs[i]) % sizeof (struct obj);
+      for (j = 0; j < (int) color_cnt; j++)
+        if (colors[j] == color)
+          break;
+      if (j == (int) color_cnt)
+        colors[color_cnt++] = color;
+    }
+  if (color_cnt < 2)
+    fail ("all slabs have the same color");
+  msg ("Slabs are colored.");
+
+  /* Give back every other object, which leaves every slab in use,
+     and take them again: there should be no new constructor
+     calls, and each object should keep its constructed state. */
+  if (ctor_cnt < OBJ_CNT)
+    fail ("constructor ran %d times for %d objects", ctor_cnt, OBJ_CNT);
+  first_ctor_cnt = ctor_cnt;
+  for (i = 1; i < OBJ_CNT; i += 2)
+    kmem_cache_free (cache, objs[i]);
+  for (i = 1; i < OBJ_CNT; i += 2)
+    {
+      objs[i] = kmem_cache_alloc (cache);
+      if (objs[i] == NULL)
+        fail ("reallocation %d failed", i);
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object lost its constructed state");
+    }
+  if (ctor_cnt != first_ctor_cnt)
+    fail ("constructor ran %d more times on reallocation",
+          ctor_cnt - first_ctor_cnt);
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (cache, objs[i]);
+  msg ("Constructor ran per object, not per allocation.");
+}
+
+static void
+obj_ctor (void *obj_) 
+{
+  struct obj *obj = obj_;
+
+  obj->magic = OBJ_MAGIC;
+  ctor_cnt++;
+}
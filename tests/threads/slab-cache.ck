@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Allocated 64 objects.
+(slab-cache) Slabs are colored.
+(slab-cache) Constructor ran per object, not per allocation.
+(slab-cache) end
+EOF
+pass;
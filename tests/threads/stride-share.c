@@ -0,0 +1,83 @@
+/* Checks that the stride scheduler divides the CPU in proportion
+   to tickets.
+
+   Three threads holding 100, 200, and 300 tickets spin for 20
+   seconds, counting the timer ticks they observe while running.
+   They should receive 1/6, 2/6, and 3/6 of those ticks, that is,
+   about 333, 667, and 1000 of the 2000 ticks, respectively.  The
+   test prints the measured ticks and the share of each thread in
+   thousandths; stride-share.ck checks the ratios. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 3
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int tickets;
+    int tick_count;
+  };
+
+static thread_func stride_thread;
+
+void
+test_stride_share (void) 
+{
+  struct thread_info info[THREAD_CNT];
+  int64_t start_time;
+  int total;
+  int i;
+
+  ASSERT (thread_stride);
+
+  start_time = timer_ticks ();
+  msg ("Starting %d threads...", THREAD_CNT);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      ti->tickets = (i + 1) * 100;
+      ti->tick_count = 0;
+
+      snprintf (name, sizeof name, "stride %d", i);
+      thread_create (name, PRI_DEFAULT, stride_thread, ti);
+    }
+
+  msg ("Sleeping 25 seconds to let threads run, please wait...");
+  timer_sleep (25 * TIMER_FREQ);
+
+  total = 0;
+  for (i = 0; i < THREAD_CNT; i++)
+    total += info[i].tick_count;
+  for (i = 0; i < THREAD_CNT; i++)
+    msg ("Thread %d with %d tickets received %d ticks (%d/1000).",
+         i, info[i].tickets, info[i].tick_count,
+         total > 0 ? info[i].tick_count * 1000 / total : 0);
+}
+
+static void
+stride_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t sleep_time = 3 * TIMER_FREQ;
+  int64_t spin_time = sleep_time + 20 * TIMER_FREQ;
+  int64_t last_time = 0;
+
+  thread_set_tickets (ti->tickets);
+  timer_sleep (sleep_time - timer_elapsed (ti->start_time));
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+}
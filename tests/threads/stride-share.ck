@@ -0,0 +1,36 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# Each thread's share of the measured ticks must be within 3% of
+# its share of the tickets.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (@tickets, @ticks);
+foreach (@output) {
+    my ($id, $tickets, $ticks)
+      = /Thread (\d+) with (\d+) tickets received (\d+) ticks/ or next;
+    $tickets[$id] = $tickets;
+    $ticks[$id] = $ticks;
+}
+fail "Expected tick counts for 3 threads.\n" if @ticks != 3;
+
+my ($total_tickets) = 0;
+my ($total_ticks) = 0;
+$total_tickets += $_ foreach @tickets;
+$total_ticks += $_ foreach @ticks;
+fail "Threads received no ticks.\n" if $total_ticks == 0;
+
+for my $i (0...$#ticks) {
+    my ($expected) = $tickets[$i] / $total_tickets;
+    my ($actual) = $ticks[$i] / $total_ticks;
+    fail sprintf ("Thread %d received %.1f%% of the ticks, "
+		  . "but holds %.1f%% of the tickets.\n",
+		  $i, $actual * 100, $expected * 100)
+      if abs ($actual - $expected) > .03;
+}
+pass;
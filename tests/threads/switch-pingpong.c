@@ -0,0 +1,88 @@
+/* Measures the cost of switching between two kernel threads.
+
+   The main thread and a partner thread of the same priority pass
+   control back and forth through a pair of semaphores for
+   RUN_TICKS ticks, so that every round trip is two semaphore
+   handoffs and two thread switches.  Each side checks that the
+   other really ran in between.
+
+   The test prints the number of round trips completed, from
+   which the cost of a switch can be read off;
+   switch-pingpong.ck only checks that they strictly
+   alternated. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define RUN_TICKS (2 * TIMER_FREQ)
+
+struct pingpong 
+  {
+    struct semaphore ping;
+    struct semaphore pong;
+    struct semaphore done;
+    bool stop;
+    long long turn;
+  };
+
+static thread_func pong_thread_func;
+
+void
+test_switch_pingpong (void) 
+{
+  struct pingpong pp;
+  long long trips = 0;
+  int64_t start, end;
+
+  sema_init (&pp.ping, 0);
+  sema_init (&pp.pong, 0);
+  sema_init (&pp.done, 0);
+  pp.stop = false;
+  pp.turn = 0;
+  thread_create ("pong", thread_get_priority (), pong_thread_func, &pp);
+
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  end = start + 1 + RUN_TICKS;
+
+  while (timer_ticks () < end)
+    {
+      if (pp.turn != 2 * trips)
+        fail ("ping ran out of turn after %lld round trips", trips);
+      pp.turn++;
+      sema_up (&pp.ping);
+      sema_down (&pp.pong);
+      trips++;
+    }
+  pp.stop = true;
+  sema_up (&pp.ping);
+  sema_down (&pp.done);
+
+  if (pp.turn != 2 * trips)
+    fail ("pong ran %lld times in %lld round trips", pp.turn - trips, trips);
+  msg ("%lld round trips in %d ticks.", trips, RUN_TICKS);
+  msg ("Threads alternated.");
+}
+
+static void
+pong_thread_func (void *pp_) 
+{
+  struct pingpong *pp = pp_;
+
+  for (;;)
+    {
+      sema_down (&pp->ping);
+      if (pp->stop)
+        break;
+      if (pp->turn % 2 != 1)
+        fail ("pong ran out of turn");
+      pp->turn++;
+      sema_up (&pp->pong);
+    }
+  sema_up (&pp->done);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# The two threads must have strictly alternated.  The round-trip
+# count varies with the host, so it is only required to be
+# nonzero.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my ($trips);
+foreach (@output) {
+    ($trips) = /(\d+) round trips/ and last;
+}
+fail "Missing round-trip count.\n" if !defined $trips;
+fail "No round trips completed.\n" if $trips == 0;
+fail "Threads did not alternate.\n"
+  if !grep ($_ eq '(switch-pingpong) Threads alternated.', @output);
+pass;
@@ -38,6 +38,16 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"stride-share", test_stride_share},
+    {"rwlock-donate", test_rwlock_donate},
+    {"rwlock-stress", test_rwlock_stress},
+    {"rwlock-bench", test_rwlock_bench},
+    {"seqlock-bench", test_seqlock_bench},
+    {"switch-pingpong", test_switch_pingpong},
+    {"hrtimer-sleep", test_hrtimer_sleep},
+    {"workqueue", test_workqueue},
+    {"alarm-slack", test_alarm_slack},
+    {"slab-cache", test_slab_cache},
   };
 
 static const char *test_name;
@@ -32,6 +32,16 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_stride_share;
+extern test_func test_rwlock_donate;
+extern test_func test_rwlock_stress;
+extern test_func test_rwlock_bench;
+extern test_func test_seqlock_bench;
+extern test_func test_switch_pingpong;
+extern test_func test_hrtimer_sleep;
+extern test_func test_workqueue;
+extern test_func test_alarm_slack;
+extern test_func test_slab_cache;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,93 @@
+/* Queues deferred work and a tasklet from a timer, that is, from
+   the timer interrupt handler, and checks that they run in a
+   worker thread with interrupts on.  The tasklet is scheduled
+   WORK_CNT times before it can run, so it must run only once,
+   and the work items must run in the order they were queued. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define WORK_CNT 3
+
+static struct semaphore done;
+static struct tasklet tasklet;
+static int tasklet_runs;
+static int work_runs;
+
+static timer_func queue_from_interrupt;
+static work_func tasklet_func;
+static work_func work_item_func;
+static void check_context (const char *what);
+
+void
+test_workqueue (void) 
+{
+  struct timer timer;
+  int i;
+
+  sema_init (&done, 0);
+  tasklet_init (&tasklet, tasklet_func, NULL);
+  timer_setup (&timer, queue_from_interrupt, NULL);
+  timer_add (&timer, timer_ticks () + 1);
+
+  for (i = 0; i < WORK_CNT + 1; i++)
+    sema_down (&done);
+
+  /* Give a duplicate tasklet run, if any, the chance to show. */
+  timer_sleep (2);
+  if (tasklet_runs != 1)
+    fail ("tasklet ran %d times", tasklet_runs);
+  msg ("Tasklet ran once.");
+  msg ("Work ran in order.");
+}
+
+/* Timer function: runs in the timer interrupt. */
+static void
+queue_from_interrupt (void *aux UNUSED) 
+{
+  int i;
+
+  ASSERT (intr_context ());
+  for (i = 0; i < WORK_CNT; i++)
+    {
+      tasklet_schedule (&tasklet);
+      if (!work_queue (work_item_func, (void *) (intptr_t) i))
+        fail ("work queue full");
+    }
+}
+
+static void
+tasklet_func (void *aux UNUSED) 
+{
+  check_context ("tasklet");
+  tasklet_runs++;
+  sema_up (&done);
+}
+
+static void
+work_item_func (void *aux) 
+{
+  int i = (intptr_t) aux;
+
+  check_context ("work");
+  if (i != work_runs)
+    fail ("work item %d ran after %d others", i, work_runs);
+  work_runs++;
+  sema_up (&done);
+}
+
+static void
+check_context (const char *what) 
+{
+  if (intr_context ())
+    fail ("%s ran in interrupt context", what);
+  if (intr_get_level () != INTR_ON)
+    fail ("%s ran with interrupts off", what);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) Tasklet ran once.
+(workqueue) Work ran in order.
+(workqueue) end
+EOF
+pass;
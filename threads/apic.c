@@ -0,0 +1,272 @@
+#include "threads/apic.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/io.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* See [IA32-v3a] chapter 10 "Advanced Programmable Interrupt
+   Controller (APIC)" for the local APIC, and [82093AA] for the
+   I/O APIC. */
+
+/* Local APIC registers, as offsets into its memory-mapped page.
+   In x2APIC mode the register at offset R is MSR 0x800 + R / 16
+   instead. */
+#define LAPIC_TPR 0x080         /* Task priority. */
+#define LAPIC_EOI 0x0b0         /* End of interrupt. */
+#define LAPIC_SVR 0x0f0         /* Spurious interrupt vector. */
+#define LAPIC_ESR 0x280         /* Error status. */
+#define LAPIC_LVT_TIMER 0x320   /* Local vector table entries. */
+#define LAPIC_LVT_LINT0 0x350
+#define LAPIC_LVT_LINT1 0x360
+#define LAPIC_LVT_ERROR 0x370
+#define LAPIC_TIMER_INIT 0x380  /* Timer initial count. */
+#define LAPIC_TIMER_CUR 0x390   /* Timer current count. */
+#define LAPIC_TIMER_DIV 0x3e0   /* Timer divide configuration. */
+
+#define SVR_ENABLE 0x100        /* APIC software enable. */
+#define LVT_NMI 0x400           /* Delivery mode NMI. */
+#define LVT_MASKED 0x10000
+#define LVT_TIMER_PERIODIC 0x20000
+#define LVT_TIMER_TSC_DEADLINE 0x40000
+#define TIMER_DIV_16 0x3        /* Timer counts at bus clock / 16. */
+
+#define MSR_APIC_BASE 0x1b
+#define APIC_BASE_X2APIC 0x400  /* x2APIC mode enable. */
+#define APIC_BASE_ENABLE 0x800  /* Global enable. */
+#define MSR_X2APIC_REGS 0x800
+#define MSR_TSC_DEADLINE 0x6e0
+
+/* CPUID leaf 1 feature flags. */
+#define CPUID_EDX_APIC (1 << 9)
+#define CPUID_ECX_X2APIC (1 << 21)
+#define CPUID_ECX_TSC_DEADLINE (1 << 24)
+
+/* I/O APIC registers, reached by writing the register number to
+   IOREGSEL and then accessing IOWIN. */
+#define IOAPIC_REGSEL 0         /* Offsets in 32-bit words. */
+#define IOAPIC_WIN 4
+#define IOAPIC_VER 0x01
+#define IOAPIC_REDTBL(PIN) (0x10 + 2 * (PIN))
+
+#define REDTBL_ACTIVE_LOW 0x2000
+#define REDTBL_LEVEL 0x8000
+#define REDTBL_MASKED 0x10000
+
+/* MP table interrupt flags. */
+#define MP_POLARITY_LOW 0x3
+#define MP_TRIGGER_LEVEL 0xc
+
+static bool x2apic;                 /* Registers accessed as MSRs? */
+static volatile uint32_t *lapic;    /* Otherwise, mapped here. */
+static volatile uint32_t *ioapic;   /* Mapped I/O APIC registers. */
+static unsigned ioapic_pins;        /* Number of I/O APIC inputs. */
+
+static volatile uint32_t *map_mmio (uint64_t phys);
+static uint32_t lapic_read (unsigned reg);
+static void lapic_write (unsigned reg, uint32_t value);
+static uint32_t ioapic_read (unsigned reg);
+static void ioapic_write (unsigned reg, uint32_t value);
+
+/* Sets up the bootstrap processor's local APIC and routes the ISA
+   IRQs through the I/O APIC.  Returns false, having changed
+   nothing, if the machine has no APIC or its registers could not
+   be mapped; the caller then keeps using the 8259 PIC. */
+bool
+apic_init (void) {
+	uint32_t eax = 1, ebx, ecx = 0, edx;
+	uint64_t base;
+	int irq;
+
+	asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+	if (!(edx & CPUID_EDX_APIC) || ioapic_phys_addr == 0)
+		return false;
+
+	base = read_msr (MSR_APIC_BASE);
+	if (lapic_phys_addr == 0)
+		lapic_phys_addr = base & 0xfffff000;
+	x2apic = (ecx & CPUID_ECX_X2APIC) != 0;
+	if (!x2apic && (lapic = map_mmio (lapic_phys_addr)) == NULL)
+		return false;
+	if ((ioapic = map_mmio (ioapic_phys_addr)) == NULL)
+		return false;
+
+	base |= APIC_BASE_ENABLE;
+	if (x2apic)
+		base |= APIC_BASE_X2APIC;
+	write_msr (MSR_APIC_BASE, base);
+
+	/* Connect the interrupt lines to the APIC instead of the PIC,
+	   if the firmware left them behind the IMCR. */
+	if (mp_imcr) {
+		outb (0x22, 0x70);
+		outb (0x23, 0x01);
+	}
+
+	/* Enable the local APIC, with everything but NMIs on LINT1
+	   masked until asked for. */
+	lapic_write (LAPIC_SVR, SVR_ENABLE | APIC_SPURIOUS_VEC);
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED);
+	lapic_write (LAPIC_LVT_LINT0, LVT_MASKED);
+	lapic_write (LAPIC_LVT_LINT1, LVT_NMI);
+	lapic_write (LAPIC_LVT_ERROR, LVT_MASKED);
+	lapic_write (LAPIC_ESR, 0);
+	lapic_write (LAPIC_ESR, 0);
+	lapic_write (LAPIC_TPR, 0);
+	lapic_write (LAPIC_EOI, 0);
+
+	/* Mask every I/O APIC input, then route ISA IRQ N to vector
+	   0x20 + N on this CPU.  IRQ 2 is the PIC cascade and is never
+	   raised; its pin often carries the timer instead. */
+	ioapic_pins = ((ioapic_read (IOAPIC_VER) >> 16) & 0xff) + 1;
+	for (unsigned pin = 0; pin < ioapic_pins; pin++) {
+		ioapic_write (IOAPIC_REDTBL (pin), REDTBL_MASKED);
+		ioapic_write (IOAPIC_REDTBL (pin) + 1, 0);
+	}
+	for (irq = 0; irq < 16; irq++) {
+		unsigned pin = isa_irq_pin[irq];
+		uint32_t entry = 0x20 + irq;
+
+		if (irq == 2 || pin >= ioapic_pins)
+			continue;
+		if ((isa_irq_flags[irq] & MP_POLARITY_LOW) == MP_POLARITY_LOW)
+			entry |= REDTBL_ACTIVE_LOW;
+		if ((isa_irq_flags[irq] & MP_TRIGGER_LEVEL) == MP_TRIGGER_LEVEL)
+			entry |= REDTBL_LEVEL;
+		ioapic_write (IOAPIC_REDTBL (pin) + 1, (uint32_t) cpus[0].apic_id << 24);
+		ioapic_write (IOAPIC_REDTBL (pin), entry);
+	}
+
+	printf ("Using %s and I/O APIC for interrupts.\n",
+			x2apic ? "x2APIC" : "local APIC");
+	return true;
+}
+
+/* Acknowledges the external interrupt being handled. */
+void
+apic_eoi (void) {
+	lapic_write (LAPIC_EOI, 0);
+}
+
+/* Masks ISA IRQ at the I/O APIC if MASKED is true, or unmasks
+   it otherwise. */
+void
+ioapic_mask_irq (int irq, bool masked) {
+	unsigned reg;
+	uint32_t entry;
+
+	ASSERT (irq >= 0 && irq < 16);
+	ASSERT (isa_irq_pin[irq] < ioapic_pins);
+
+	reg = IOAPIC_REDTBL (isa_irq_pin[irq]);
+	entry = ioapic_read (reg);
+	if (masked)
+		entry |= REDTBL_MASKED;
+	else
+		entry &= ~REDTBL_MASKED;
+	ioapic_write (reg, entry);
+}
+
+/* Returns the current count of the local APIC timer. */
+uint32_t
+lapic_timer_count (void) {
+	return lapic_read (LAPIC_TIMER_CUR);
+}
+
+/* Starts the local APIC timer raising vector VEC every COUNT
+   timer clocks. */
+void
+lapic_timer_periodic (uint8_t vec, uint32_t count) {
+	lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+	lapic_write (LAPIC_LVT_TIMER, LVT_TIMER_PERIODIC | vec);
+	lapic_write (LAPIC_TIMER_INIT, count);
+}
+
+/* Starts the local APIC timer counting down once from COUNT,
+   raising vector VEC when it reaches zero, or nothing if VEC is
+   0. */
+void
+lapic_timer_oneshot (uint8_t vec, uint32_t count) {
+	lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+	lapic_write (LAPIC_LVT_TIMER, vec != 0 ? vec : LVT_MASKED);
+	lapic_write (LAPIC_TIMER_INIT, count);
+}
+
+/* Returns true if the local APIC timer has TSC-deadline mode. */
+bool
+lapic_has_tsc_deadline (void) {
+	uint32_t eax = 1, ebx, ecx = 0, edx;
+
+	asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+	return (ecx & CPUID_ECX_TSC_DEADLINE) != 0;
+}
+
+/* Puts the local APIC timer in TSC-deadline mode, raising vector
+   VEC when the TSC reaches the deadline set with
+   lapic_timer_deadline().  No deadline is armed yet. */
+void
+lapic_timer_deadline_mode (uint8_t vec) {
+	lapic_write (LAPIC_LVT_TIMER, LVT_TIMER_TSC_DEADLINE | vec);
+
+	/* In x2APIC mode the LVT write is a WRMSR, which does not
+	   order itself against the deadline WRMSR that follows. */
+	asm volatile ("mfence" : : : "memory");
+}
+
+/* Arms the local APIC timer, which must be in TSC-deadline mode,
+   to interrupt once when the TSC reaches TSC.  A deadline already
+   passed interrupts at once; 0 disarms the timer. */
+void
+lapic_timer_deadline (uint64_t tsc) {
+	write_msr (MSR_TSC_DEADLINE, tsc);
+}
+
+/* Maps the page of device registers at physical address PHYS into
+   the kernel's address space, uncached, and returns its kernel
+   virtual address, or a null pointer if a page table could not be
+   allocated. */
+static volatile uint32_t *
+map_mmio (uint64_t phys) {
+	uint64_t page = phys & ~(uint64_t) PGMASK;
+	uint64_t *pte = pml4e_walk (base_pml4, (uint64_t) ptov (page), 1);
+
+	if (pte == NULL)
+		return NULL;
+	*pte = page | PTE_P | PTE_W | PTE_PCD;
+
+	/* The page was mapped cacheable before, possibly as part of a
+	   large page, and the TLB may still hold that translation. */
+	invlpg ((uint64_t) ptov (page));
+	return ptov (phys);
+}
+
+static uint32_t
+lapic_read (unsigned reg) {
+	if (x2apic)
+		return read_msr (MSR_X2APIC_REGS + reg / 16);
+	return lapic[reg / 4];
+}
+
+static void
+lapic_write (unsigned reg, uint32_t value) {
+	if (x2apic)
+		write_msr (MSR_X2APIC_REGS + reg / 16, value);
+	else
+		lapic[reg / 4] = value;
+}
+
+static uint32_t
+ioapic_read (unsigned reg) {
+	ioapic[IOAPIC_REGSEL] = reg;
+	return ioapic[IOAPIC_WIN];
+}
+
+static void
+ioapic_write (unsigned reg, uint32_t value) {
+	ioapic[IOAPIC_REGSEL] = reg;
+	ioapic[IOAPIC_WIN] = value;
+}
@@ -0,0 +1,232 @@
+#include "threads/cpu.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/vaddr.h"
+
+/* See [MPS] for the layout of the MultiProcessor Specification
+   tables that the BIOS leaves in low memory. */
+
+struct cpu cpus[CPU_MAX] = {
+	{ .id = 0, .bsp = true },
+};
+unsigned cpu_cnt = 1;
+
+uint64_t lapic_phys_addr;
+uint64_t ioapic_phys_addr;
+uint8_t ioapic_id;
+uint8_t isa_irq_pin[16];
+uint16_t isa_irq_flags[16];
+bool mp_imcr;
+
+/* MP floating pointer structure. */
+struct mp_float {
+	char signature[4];          /* "_MP_". */
+	uint32_t config;            /* Physical address of mp_config. */
+	uint8_t length;             /* In 16-byte units. */
+	uint8_t spec_rev;
+	uint8_t checksum;
+	uint8_t features[5];
+#define MP_FEATURE2_IMCRP 0x80  /* In features[1]. */
+} __attribute__ ((packed));
+
+/* MP configuration table header, followed by ENTRY_CNT entries. */
+struct mp_config {
+	char signature[4];          /* "PCMP". */
+	uint16_t length;            /* Base table length, in bytes. */
+	uint8_t spec_rev;
+	uint8_t checksum;
+	char oem_id[8];
+	char product_id[12];
+	uint32_t oem_table;
+	uint16_t oem_table_size;
+	uint16_t entry_cnt;
+	uint32_t lapic_addr;        /* Local APIC address. */
+	uint16_t ext_length;
+	uint8_t ext_checksum;
+	uint8_t reserved;
+} __attribute__ ((packed));
+
+/* Configuration table entry types.  A processor entry is 20 bytes
+   long, every other kind 8 bytes. */
+#define MP_PROC 0
+#define MP_BUS 1
+#define MP_IOAPIC 2
+#define MP_IOINTR 3
+
+/* Processor entry. */
+struct mp_proc {
+	uint8_t type;               /* MP_PROC. */
+	uint8_t apic_id;
+	uint8_t apic_ver;
+	uint8_t flags;
+#define MP_PROC_ENABLED 0x01
+	uint32_t signature;
+	uint32_t features;
+	uint32_t reserved[2];
+} __attribute__ ((packed));
+
+/* I/O APIC entry. */
+struct mp_ioapic {
+	uint8_t type;               /* MP_IOAPIC. */
+	uint8_t apic_id;
+	uint8_t apic_ver;
+	uint8_t flags;
+#define MP_IOAPIC_ENABLED 0x01
+	uint32_t addr;
+} __attribute__ ((packed));
+
+/* Bus entry. */
+struct mp_bus {
+	uint8_t type;               /* MP_BUS. */
+	uint8_t bus_id;
+	char bus_type[6];           /* "ISA   ", "PCI   ", ... */
+} __attribute__ ((packed));
+
+/* I/O interrupt assignment entry. */
+struct mp_intr {
+	uint8_t type;               /* MP_IOINTR. */
+	uint8_t intr_type;          /* 0 for a vectored interrupt. */
+	uint16_t flags;             /* Polarity and trigger mode. */
+	uint8_t src_bus_id;
+	uint8_t src_bus_irq;
+	uint8_t dst_apic_id;
+	uint8_t dst_pin;
+} __attribute__ ((packed));
+
+static struct mp_config *mp_config_find (void);
+static struct mp_float *mp_search (uint64_t phys, size_t size);
+static bool checksum_ok (const void *, size_t size);
+static uint8_t cpuid_apic_id (void);
+
+/* Finds the processors and I/O APICs in the machine, from the MP
+   configuration table.  The application processors are only
+   recorded; the kernel runs on the bootstrap processor alone. */
+void
+cpu_init (void) {
+	struct mp_config *conf;
+	uint8_t *p, *end;
+	uint8_t bsp_apic_id = cpuid_apic_id ();
+	int isa_bus_id = -1;
+	int irq;
+
+	for (irq = 0; irq < 16; irq++)
+		isa_irq_pin[irq] = irq;
+	cpus[0].apic_id = bsp_apic_id;
+
+	conf = mp_config_find ();
+	if (conf == NULL)
+		return;
+	lapic_phys_addr = conf->lapic_addr;
+
+	p = (uint8_t *) (conf + 1);
+	end = (uint8_t *) conf + conf->length;
+	while (p < end) {
+		if (*p == MP_PROC) {
+			struct mp_proc *proc = (struct mp_proc *) p;
+
+			if ((proc->flags & MP_PROC_ENABLED)
+					&& proc->apic_id != bsp_apic_id && cpu_cnt < CPU_MAX) {
+				struct cpu *c = &cpus[cpu_cnt];
+
+				c->id = cpu_cnt++;
+				c->apic_id = proc->apic_id;
+			}
+			p += sizeof *proc;
+		} else {
+			if (*p == MP_BUS) {
+				struct mp_bus *bus = (struct mp_bus *) p;
+
+				if (memcmp (bus->bus_type, "ISA", 3) == 0)
+					isa_bus_id = bus->bus_id;
+			} else if (*p == MP_IOAPIC) {
+				struct mp_ioapic *ioapic = (struct mp_ioapic *) p;
+
+				if ((ioapic->flags & MP_IOAPIC_ENABLED) && ioapic_phys_addr == 0) {
+					ioapic_phys_addr = ioapic->addr;
+					ioapic_id = ioapic->apic_id;
+				}
+			} else if (*p == MP_IOINTR) {
+				/* Bus entries come first, so the ISA bus is known
+				   by now. */
+				struct mp_intr *intr = (struct mp_intr *) p;
+
+				if (intr->intr_type == 0 && intr->src_bus_id == isa_bus_id
+						&& intr->src_bus_irq < 16
+						&& (intr->dst_apic_id == ioapic_id || intr->dst_apic_id == 0xff)) {
+					isa_irq_pin[intr->src_bus_irq] = intr->dst_pin;
+					isa_irq_flags[intr->src_bus_irq] = intr->flags;
+				}
+			}
+			p += 8;
+		}
+	}
+
+	if (cpu_cnt > 1)
+		printf ("%u CPUs found, running on the bootstrap processor.\n",
+				cpu_cnt);
+}
+
+/* Returns the MP configuration table, or a null pointer if the
+   BIOS did not provide a valid one. */
+static struct mp_config *
+mp_config_find (void) {
+	uint64_t ebda = (uint64_t) *(uint16_t *) ptov (0x40e) << 4;
+	uint64_t base_kb = *(uint16_t *) ptov (0x413);
+	struct mp_float *mp = NULL;
+	struct mp_config *conf;
+
+	/* The floating pointer lives in the first KB of the extended
+	   BIOS data area, in the last KB of base memory, or in the
+	   BIOS ROM. */
+	if (ebda != 0)
+		mp = mp_search (ebda, 1024);
+	if (mp == NULL && base_kb != 0)
+		mp = mp_search (base_kb * 1024 - 1024, 1024);
+	if (mp == NULL)
+		mp = mp_search (0xf0000, 0x10000);
+	if (mp == NULL || mp->config == 0)
+		return NULL;
+	mp_imcr = (mp->features[1] & MP_FEATURE2_IMCRP) != 0;
+
+	conf = ptov (mp->config);
+	if (memcmp (conf->signature, "PCMP", 4) != 0
+			|| (conf->spec_rev != 1 && conf->spec_rev != 4)
+			|| !checksum_ok (conf, conf->length))
+		return NULL;
+	return conf;
+}
+
+/* Looks for the MP floating pointer structure in the SIZE bytes
+   of physical memory starting at PHYS. */
+static struct mp_float *
+mp_search (uint64_t phys, size_t size) {
+	uint8_t *p = ptov (phys);
+	uint8_t *end = p + size;
+
+	for (; p + sizeof (struct mp_float) <= end; p += 16)
+		if (memcmp (p, "_MP_", 4) == 0
+				&& checksum_ok (p, sizeof (struct mp_float)))
+			return (struct mp_float *) p;
+	return NULL;
+}
+
+/* Returns true if the SIZE bytes at P add up to 0 modulo 256. */
+static bool
+checksum_ok (const void *p_, size_t size) {
+	const uint8_t *p = p_;
+	uint8_t sum = 0;
+
+	while (size-- > 0)
+		sum += *p++;
+	return sum == 0;
+}
+
+/* Returns the initial local APIC ID of the running CPU. */
+static uint8_t
+cpuid_apic_id (void) {
+	uint32_t eax = 1, ebx, ecx = 0, edx;
+
+	asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+	return ebx >> 24;
+}
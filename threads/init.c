@@ -13,6 +13,7 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -20,7 +21,9 @@
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -84,8 +87,10 @@ main (void) {
 
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
+	slab_init ();
 	malloc_init ();
 	paging_init (mem_end);
+	cpu_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -103,6 +108,8 @@ main (void) {
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
+	workqueue_init ();
+	palloc_zero_init ();
 	serial_init_queue ();
 	timer_calibrate ();
 
@@ -140,28 +147,84 @@ bss_init (void) {
 	memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Returns true if the CPU supports 1 GB pages. */
+static bool
+cpu_has_huge_pages (void) {
+	uint32_t eax = 0x80000000, ebx, ecx = 0, edx;
+
+	asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+	if (eax < 0x80000001)
+		return false;
+	eax = 0x80000001;
+	ecx = 0;
+	asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+	return (edx & (1u << 26)) != 0;
+}
+
+/* Returns the size of the largest page that can map physical
+ * address PA in the kernel's direct map below MEM_END: a 1 GB
+ * page if HUGE_OK, or a 2 MB page, if PA and its virtual address
+ * are aligned to it and it stays clear of the kernel text, which
+ * is mapped read-only, and of the first 2 MB, whose memory types
+ * the MTRRs set in small pieces; PGSIZE otherwise. */
+static uint64_t
+direct_map_size (uint64_t pa, uint64_t mem_end, bool huge_ok) {
+	extern char start, _end_kernel_text;
+	uint64_t text_start = vtop (&start);
+	uint64_t text_end = vtop (&_end_kernel_text);
+	uint64_t size;
+
+	for (size = huge_ok ? HUGE_PGSIZE : LARGE_PGSIZE; size > PGSIZE;
+			size >>= PDXSHIFT - PTXSHIFT)
+		if (pa >= LARGE_PGSIZE && pa % size == 0
+				&& (uint64_t) ptov (pa) % size == 0
+				&& pa + size <= mem_end
+				&& (pa + size <= text_start || pa >= text_end))
+			break;
+	return size;
+}
+
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ * Maps memory with the largest pages that direct_map_size()
+ * allows, which saves page tables and TLB entries. */
 static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
+	uint64_t size;
+	size_t huge_cnt = 0, large_cnt = 0, small_cnt = 0;
+	bool huge_ok = cpu_has_huge_pages ();
 	int perm;
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	for (uint64_t pa = 0; pa < mem_end; pa += size) {
 		uint64_t va = (uint64_t) ptov(pa);
 
+		size = direct_map_size (pa, mem_end, huge_ok);
+		if (size > PGSIZE) {
+			if (!pml4_set_large_page (pml4, va, pa, size, PTE_P | PTE_W))
+				PANIC ("paging_init: out of memory");
+			if (size == HUGE_PGSIZE)
+				huge_cnt++;
+			else
+				large_cnt++;
+			continue;
+		}
+
 		perm = PTE_P | PTE_W;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
 		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
 			*pte = pa | perm;
+		small_cnt++;
 	}
+	printf ("Kernel direct map: %zu 1 GB, %zu 2 MB, %zu 4 kB pages\n",
+			huge_cnt, large_cnt, small_cnt);
 
 	// reload cr3
 	pml4_activate(0);
@@ -221,6 +284,12 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-stride"))
+			thread_stride = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-apic"))
+			intr_apic = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -231,6 +300,9 @@ parse_options (char **argv) {
 			PANIC ("unknown option `%s' (use -h for help)", name);
 	}
 
+	if (thread_mlfqs && thread_stride)
+		PANIC ("-mlfqs and -stride cannot be used together");
+
 	return argv;
 }
 
@@ -326,6 +398,9 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -stride            Use stride (proportional-share) scheduler.\n"
+			"  -tickless          Stop the periodic timer tick while idle.\n"
+			"  -apic              Use the local and I/O APIC, if present.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -354,6 +429,8 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	kmem_cache_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -3,6 +3,7 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "threads/apic.h"
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
@@ -103,9 +104,16 @@ static const char *intr_names[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* If true, use the local and I/O APIC instead of the 8259 PIC,
+   if the machine has them.  Controlled by kernel command-line
+   option "-apic", and cleared by intr_init() if no APIC is found. */
+bool intr_apic;
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
+static void pic_mask_all (void);
 static void pic_end_of_interrupt (int irq);
+static intr_handler_func apic_spurious;
 
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
@@ -164,8 +172,16 @@ void
 intr_init (void) {
 	int i;
 
-	/* Initialize interrupt controller. */
+	/* Initialize interrupt controller.  The PIC is set up even when
+	   it is not used, so that any spurious interrupt it raises
+	   lands on a vector we know. */
 	pic_init ();
+	if (intr_apic) {
+		if (apic_init ())
+			pic_mask_all ();
+		else
+			intr_apic = false;
+	}
 
 	/* Initialize IDT. */
 	for (i = 0; i < INTR_CNT; i++) {
@@ -181,6 +197,10 @@ intr_init (void) {
 	/* Load IDT register. */
 	lidt(&idt_desc);
 
+	if (intr_apic)
+		intr_register_int (APIC_SPURIOUS_VEC, 0, INTR_OFF, apic_spurious,
+				"APIC spurious");
+
 	/* Initialize intr_names. */
 	intr_names[0] = "#DE Divide Error";
 	intr_names[1] = "#DB Debug Exception";
@@ -308,6 +328,13 @@ pic_init (void) {
 	outb (0xa1, 0x00);
 }
 
+/* Masks every interrupt on both PICs, when the APIC takes over. */
+static void
+pic_mask_all (void) {
+	outb (0x21, 0xff);
+	outb (0xa1, 0xff);
+}
+
 /* Sends an end-of-interrupt signal to the PIC for the given IRQ.
    If we don't acknowledge the IRQ, it will never be delivered to
    us again, so this is important.  */
@@ -367,13 +394,23 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_context ());
 
 		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
+		if (intr_apic)
+			apic_eoi ();
+		else
+			pic_end_of_interrupt (frame->vec_no);
 
 		if (yield_on_return)
-			thread_yield ();
+			thread_preempt ();
 	}
 }
 
+/* The local APIC raises its spurious vector when an interrupt
+   goes away before it can be delivered.  There is nothing to do,
+   not even an EOI. */
+static void
+apic_spurious (struct intr_frame *f UNUSED) {
+}
+
 /* Dumps interrupt frame F to the console, for debugging. */
 void
 intr_dump_frame (const struct intr_frame *f) {
@@ -5,8 +5,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -25,8 +28,19 @@
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
-   blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   blocks, and the descriptor already keeps ARENA_EMPTY_MAX such
+   arenas, we remove all of the arena's blocks from the free list
+   and give the arena back to the page allocator.  Keeping a few
+   empty arenas stops a descriptor that hovers around an arena
+   boundary from getting and freeing a page on every call.
+
+   In front of the descriptors, each thread has a "magazine" of
+   free blocks for each block size.  malloc() and free() of a
+   normal block only take from or add to the current thread's
+   magazine, with no lock.  An empty magazine is refilled, and a
+   full one drained, MAG_BATCH blocks at a time under a single
+   acquisition of the descriptor's lock.  A thread's magazines go
+   back to the descriptors when it exits.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
@@ -39,9 +53,16 @@ struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
 	struct list free_list;      /* List of free blocks. */
+	size_t empty_cnt;           /* Arenas with no blocks in use. */
 	struct lock lock;           /* Lock. */
 };
 
+/* Most descriptors there can be. */
+#define DESC_MAX 10
+
+/* Empty arenas each descriptor keeps before freeing pages. */
+#define ARENA_EMPTY_MAX 2
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -57,12 +78,37 @@ struct block {
 	struct list_elem free_elem; /* Free list element. */
 };
 
+/* Blocks a magazine holds, and blocks moved to or from a
+   descriptor at a time. */
+#define MAG_SIZE 16
+#define MAG_BATCH (MAG_SIZE / 2)
+
+/* A thread's cache of free blocks of one size. */
+struct magazine {
+	size_t cnt;                 /* Number of blocks in ROUNDS. */
+	struct block *rounds[MAG_SIZE]; /* Free blocks, newest last. */
+};
+
+/* A thread's magazines, one for each descriptor. */
+struct magazines {
+	struct magazine mags[DESC_MAX];
+};
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[DESC_MAX]; /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Cache that struct magazines come from. */
+static struct kmem_cache *magazines_cache;
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *desc_get_block (struct desc *);
+static void desc_put_block (struct desc *, struct block *);
+static struct magazine *thread_magazine (struct desc *);
+static bool magazine_refill (struct desc *, struct magazine *);
+static void magazine_drain (struct desc *, struct magazine *, size_t cnt);
+static kmem_ctor_func magazines_ctor;
 
 /* Initializes the malloc() descriptors. */
 void
@@ -75,8 +121,28 @@ malloc_init (void) {
 		d->block_size = block_size;
 		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
 		list_init (&d->free_list);
+		d->empty_cnt = 0;
 		lock_init (&d->lock);
 	}
+	magazines_cache = kmem_cache_create ("magazines",
+			sizeof (struct magazines), magazines_ctor);
+}
+
+/* Gives the current thread's magazines back to the descriptors.
+   Called by thread_exit(). */
+void
+malloc_thread_exit (void) {
+	struct thread *t = thread_current ();
+	struct magazines *mags = t->magazines;
+	size_t i;
+
+	if (mags == NULL)
+		return;
+
+	t->magazines = NULL;
+	for (i = 0; i < desc_cnt; i++)
+		magazine_drain (&descs[i], &mags->mags[i], mags->mags[i].cnt);
+	kmem_cache_free (magazines_cache, mags);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -86,6 +152,7 @@ malloc (size_t size) {
 	struct desc *d;
 	struct block *b;
 	struct arena *a;
+	struct magazine *m;
 
 	/* A null pointer satisfies a request for 0 bytes. */
 	if (size == 0)
@@ -112,33 +179,17 @@ malloc (size_t size) {
 		return a + 1;
 	}
 
-	lock_acquire (&d->lock);
-
-	/* If the free list is empty, create a new arena. */
-	if (list_empty (&d->free_list)) {
-		size_t i;
-
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
+	/* Take the newest block in our magazine, refilling it first
+	   if it is empty. */
+	m = thread_magazine (d);
+	if (m != NULL) {
+		if (m->cnt == 0 && !magazine_refill (d, m))
 			return NULL;
-		}
-
-		/* Initialize arena and add its blocks to the free list. */
-		a->magic = ARENA_MAGIC;
-		a->desc = d;
-		a->free_cnt = d->blocks_per_arena;
-		for (i = 0; i < d->blocks_per_arena; i++) {
-			struct block *b = arena_to_block (a, i);
-			list_push_back (&d->free_list, &b->free_elem);
-		}
+		return m->rounds[--m->cnt];
 	}
 
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
+	lock_acquire (&d->lock);
+	b = desc_get_block (d);
 	lock_release (&d->lock);
 	return b;
 }
@@ -213,23 +264,18 @@ free (void *p) {
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+			/* Put it in our magazine, making room first if it is
+			   full. */
+			struct magazine *m = thread_magazine (d);
+			if (m != NULL) {
+				if (m->cnt == MAG_SIZE)
+					magazine_drain (d, m, MAG_BATCH);
+				m->rounds[m->cnt++] = b;
+				return;
 			}
 
+			lock_acquire (&d->lock);
+			desc_put_block (d, b);
 			lock_release (&d->lock);
 		} else {
 			/* It's a big block.  Free its pages. */
@@ -266,3 +312,140 @@ arena_to_block (struct arena *a, size_t idx) {
 			+ sizeof *a
 			+ idx * a->desc->block_size);
 }
+
+/* Takes a free block from descriptor D, whose lock must be held,
+   creating a new arena if D has no free blocks.  Returns a null
+   pointer if memory is not available. */
+static struct block *
+desc_get_block (struct desc *d) {
+	struct block *b;
+	struct arena *a;
+
+	ASSERT (lock_held_by_current_thread (&d->lock));
+
+	/* If the free list is empty, create a new arena. */
+	if (list_empty (&d->free_list)) {
+		size_t i;
+
+		/* Allocate a page. */
+		a = palloc_get_page (0);
+		if (a == NULL)
+			return NULL;
+
+		/* Initialize arena and add its blocks to the free list. */
+		a->magic = ARENA_MAGIC;
+		a->desc = d;
+		a->free_cnt = d->blocks_per_arena;
+		for (i = 0; i < d->blocks_per_arena; i++) {
+			struct block *b = arena_to_block (a, i);
+			list_push_back (&d->free_list, &b->free_elem);
+		}
+		d->empty_cnt++;
+	}
+
+	/* Get a block from free list. */
+	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+	a = block_to_arena (b);
+	if (a->free_cnt-- == d->blocks_per_arena)
+		d->empty_cnt--;
+	return b;
+}
+
+/* Gives block B back to descriptor D, whose lock must be held. */
+static void
+desc_put_block (struct desc *d, struct block *b) {
+	struct arena *a = block_to_arena (b);
+
+	ASSERT (lock_held_by_current_thread (&d->lock));
+	ASSERT (a->desc == d);
+
+	/* Add block to free list. */
+	list_push_front (&d->free_list, &b->free_elem);
+
+	/* If the arena is now entirely unused, keep it for later if we
+	   have few such arenas, or else free it. */
+	if (++a->free_cnt >= d->blocks_per_arena) {
+		size_t i;
+
+		ASSERT (a->free_cnt == d->blocks_per_arena);
+		if (d->empty_cnt < ARENA_EMPTY_MAX) {
+			d->empty_cnt++;
+			return;
+		}
+		for (i = 0; i < d->blocks_per_arena; i++) {
+			struct block *b = arena_to_block (a, i);
+			list_remove (&b->free_elem);
+		}
+		palloc_free_page (a);
+	}
+}
+
+/* Returns the current thread's magazine for descriptor D,
+   allocating the thread's magazines if it has none yet.  Returns
+   a null pointer if that fails, in which case the caller goes to
+   D directly. */
+static struct magazine *
+thread_magazine (struct desc *d) {
+	struct thread *t = thread_current ();
+
+	ASSERT (!intr_context ());
+
+	if (t->magazines == NULL) {
+		if (magazines_cache == NULL)
+			return NULL;
+		t->magazines = kmem_cache_alloc (magazines_cache);
+		if (t->magazines == NULL)
+			return NULL;
+	}
+	return &t->magazines->mags[d - descs];
+}
+
+/* Moves up to MAG_BATCH blocks from descriptor D into empty
+   magazine M.  Returns false if not even one block is
+   available. */
+static bool
+magazine_refill (struct desc *d, struct magazine *m) {
+	ASSERT (m->cnt == 0);
+
+	lock_acquire (&d->lock);
+	while (m->cnt < MAG_BATCH) {
+		struct block *b = desc_get_block (d);
+		if (b == NULL)
+			break;
+		m->rounds[m->cnt++] = b;
+	}
+	lock_release (&d->lock);
+	return m->cnt > 0;
+}
+
+/* Gives the CNT oldest blocks in magazine M back to descriptor
+   D, keeping the newest, which are likely still in the CPU's
+   cache. */
+static void
+magazine_drain (struct desc *d, struct magazine *m, size_t cnt) {
+	size_t i;
+
+	ASSERT (cnt <= m->cnt);
+
+	if (cnt == 0)
+		return;
+
+	lock_acquire (&d->lock);
+	for (i = 0; i < cnt; i++)
+		desc_put_block (d, m->rounds[i]);
+	lock_release (&d->lock);
+
+	m->cnt -= cnt;
+	memmove (m->rounds, m->rounds + cnt, m->cnt * sizeof *m->rounds);
+}
+
+/* Constructs a struct magazines with every magazine empty, the
+   state that malloc_thread_exit() gives them back in. */
+static void
+magazines_ctor (void *mags_) {
+	struct magazines *mags = mags_;
+	size_t i;
+
+	for (i = 0; i < DESC_MAX; i++)
+		mags->mags[i].cnt = 0;
+}
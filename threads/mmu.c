@@ -8,8 +8,33 @@
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Returns the physical address of the SIZE-byte large page that
+ * the PDE or PDPE ENTRY maps. */
+#define LARGE_ADDR(entry, size) (PTE_ADDR (entry) & ~((size) - 1))
+
+/* Replaces the large-page entry *ENTRY, which maps SIZE bytes at
+ * VA, by a pointer to a new table whose entries map the same
+ * memory, with the same permissions, in pieces 512 times smaller.
+ * Returns false if memory for the table is not available. */
+static bool
+split_large (uint64_t *entry, uint64_t size, const uint64_t va) {
+	uint64_t *table = palloc_get_page (0);
+	uint64_t step = size / (PGSIZE / sizeof *table);
+	uint64_t flags = (*entry & PTE_FLAGS & ~PTE_PS)
+		| (step > PGSIZE ? PTE_PS : 0);
+	uint64_t pa = LARGE_ADDR (*entry, size);
+
+	if (table == NULL)
+		return false;
+	for (unsigned i = 0; i < PGSIZE / sizeof *table; i++)
+		table[i] = (pa + i * step) | flags;
+	*entry = vtop (table) | PTE_U | PTE_W | PTE_P;
+	invlpg (va);
+	return true;
+}
+
 static uint64_t *
-pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
+pgdir_walk (uint64_t *pdp, const uint64_t va, int create, uint64_t *size) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
@@ -22,14 +47,22 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 					return NULL;
 			} else
 				return NULL;
+		} else if (pdp[idx] & PTE_PS) {
+			if (!create) {
+				*size = LARGE_PGSIZE;
+				return &pdp[idx];
+			}
+			if (!split_large (&pdp[idx], LARGE_PGSIZE, va))
+				return NULL;
 		}
+		*size = PGSIZE;
 		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
 	}
 	return NULL;
 }
 
 static uint64_t *
-pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
+pdpe_walk (uint64_t *pdpe, const uint64_t va, int create, uint64_t *size) {
 	uint64_t *pte = NULL;
 	int idx = PDPE (va);
 	int allocated = 0;
@@ -45,8 +78,15 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 					return NULL;
 			} else
 				return NULL;
+		} else if (pdpe[idx] & PTE_PS) {
+			if (!create) {
+				*size = HUGE_PGSIZE;
+				return &pdpe[idx];
+			}
+			if (!split_large (&pdpe[idx], HUGE_PGSIZE, va))
+				return NULL;
 		}
-		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create);
+		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create, size);
 	}
 	if (pte == NULL && allocated) {
 		palloc_free_page ((void *) ptov (PTE_ADDR (pdpe[idx])));
@@ -55,14 +95,11 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 	return pte;
 }
 
-/* Returns the address of the page table entry for virtual
- * address VADDR in page map level 4, pml4.
- * If PML4E does not have a page table for VADDR, behavior depends
- * on CREATE.  If CREATE is true, then a new page table is
- * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
-uint64_t *
-pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
+/* Like pml4e_walk(), but also stores in *SIZE the size of the
+ * page that the returned entry maps. */
+static uint64_t *
+pml4e_walk_size (uint64_t *pml4e, const uint64_t va, int create,
+		uint64_t *size) {
 	uint64_t *pte = NULL;
 	int idx = PML4 (va);
 	int allocated = 0;
@@ -79,7 +116,7 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
-		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create);
+		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create, size);
 	}
 	if (pte == NULL && allocated) {
 		palloc_free_page ((void *) ptov (PTE_ADDR (pml4e[idx])));
@@ -88,6 +125,68 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the address of the page table entry for virtual
+ * address VADDR in page map level 4, pml4.
+ * If PML4E does not have a page table for VADDR, behavior depends
+ * on CREATE.  If CREATE is true, then a new page table is
+ * created and a pointer into it is returned.  Otherwise, a null
+ * pointer is returned.
+ * If VADDR lies in a large page, then with CREATE false this
+ * returns the PDE or PDPE that maps it, which has PTE_PS set;
+ * with CREATE true the large page is first split down into 4 kB
+ * pages, so that the returned entry maps VADDR's page alone. */
+uint64_t *
+pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
+	uint64_t size;
+	return pml4e_walk_size (pml4e, va, create, &size);
+}
+
+/* Returns the address of the PDE or PDPE entry for virtual
+ * address VA in PML4, creating page tables as needed, so that it
+ * can map a large page of SIZE bytes, LARGE_PGSIZE or HUGE_PGSIZE.
+ * Returns a null pointer if memory is not available. */
+static uint64_t *
+large_entry_walk (uint64_t *pml4, const uint64_t va, uint64_t size) {
+	uint64_t *entry = &pml4[PML4 (va)];
+
+	for (int shift = PDPESHIFT; ; shift -= PDXSHIFT - PTXSHIFT) {
+		uint64_t *table;
+
+		if (!(*entry & PTE_P)) {
+			uint64_t *new_page = palloc_get_page (PAL_ZERO);
+			if (new_page == NULL)
+				return NULL;
+			*entry = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		}
+		ASSERT (!(*entry & PTE_PS));
+		table = ptov (PTE_ADDR (*entry));
+		entry = &table[(va >> shift) & 0x1FF];
+		if (((uint64_t) 1 << shift) == size)
+			return entry;
+	}
+}
+
+/* Maps the SIZE-byte large page at physical address PA to
+ * virtual address VA in PML4, with permission bits PERM.  SIZE
+ * must be LARGE_PGSIZE or HUGE_PGSIZE, VA and PA must be aligned
+ * to it, and nothing may be mapped there yet.  Returns true if
+ * successful, false if memory allocation failed. */
+bool
+pml4_set_large_page (uint64_t *pml4, uint64_t va, uint64_t pa,
+		uint64_t size, uint64_t perm) {
+	uint64_t *entry;
+
+	ASSERT (size == LARGE_PGSIZE || size == HUGE_PGSIZE);
+	ASSERT (va % size == 0 && pa % size == 0);
+
+	entry = large_entry_walk (pml4, va, size);
+	if (entry == NULL)
+		return false;
+	ASSERT (!(*entry & PTE_P));
+	*entry = pa | perm | PTE_PS;
+	return true;
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -122,10 +221,17 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
-					pml4_index, pdp_index, i))
+		if (!(((uint64_t) pte) & PTE_P))
+			continue;
+		if (pdp[i] & PTE_PS) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
 				return false;
+		} else if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
+					pml4_index, pdp_index, i))
+			return false;
 	}
 	return true;
 }
@@ -135,15 +241,23 @@ pdp_for_each (uint64_t *pdp,
 		pte_for_each_func *func, void *aux, unsigned pml4_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pde) & PTE_P)
-			if (!pgdir_for_each ((uint64_t *) PTE_ADDR (pde), func,
-					 aux, pml4_index, i))
+		if (!(((uint64_t) pde) & PTE_P))
+			continue;
+		if (pdp[i] & PTE_PS) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) i << PDPESHIFT));
+			if (!func (&pdp[i], va, aux))
 				return false;
+		} else if (!pgdir_for_each ((uint64_t *) PTE_ADDR (pde), func,
+					 aux, pml4_index, i))
+			return false;
 	}
 	return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+ * A large page is visited once, through its PDE or PDPE, which
+ * has PTE_PS set. */
 bool
 pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
@@ -169,7 +283,7 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((((uint64_t) pte) & PTE_P) && !(pdp[i] & PTE_PS))
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -179,7 +293,7 @@ static void
 pdpe_destroy (uint64_t *pdpe) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdpe[i]);
-		if (((uint64_t) pde) & PTE_P)
+		if ((((uint64_t) pde) & PTE_P) && !(pdpe[i] & PTE_PS))
 			pgdir_destroy ((void *) PTE_ADDR (pde));
 	}
 	palloc_free_page ((void *) pdpe);
@@ -214,10 +328,11 @@ void *
 pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	ASSERT (is_user_vaddr (uaddr));
 
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
+	uint64_t size;
+	uint64_t *pte = pml4e_walk_size (pml4, (uint64_t) uaddr, 0, &size);
 
 	if (pte && (*pte & PTE_P))
-		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+		return ptov (LARGE_ADDR (*pte, size)) + ((uint64_t) uaddr & (size - 1));
 	return NULL;
 }
 
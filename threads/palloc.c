@@ -1,15 +1,17 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,13 +26,60 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Its free pages form
+   blocks of 2**K pages, for "orders" K from 0 to BUDDY_ORDERS - 1,
+   each aligned to its own size relative to the pool's base, and
+   kept on one free list per order.  An allocation takes a block
+   of the smallest sufficient order, splitting a larger one in
+   halves if need be, and gives back the pages it does not need.
+   Freeing a block merges it with its "buddy", the other half of
+   the block of the next order up, for as long as that buddy is
+   free too.  Both take time logarithmic in the block size rather
+   than linear in the size of the pool, and merging keeps free
+   memory in large blocks for multi-page requests.
+
+   Each pool also keeps a stack of up to ZERO_HIGH pages that the
+   "kzerod" thread has already filled with zeros, so that a
+   single-page PAL_ZERO request need not clear its page while the
+   caller waits.  kzerod runs at PRI_MIN, so it mostly uses time
+   that would otherwise be idle.  It is woken when a request
+   leaves fewer than ZERO_LOW zeroed pages and refills the stack
+   from free pages, but only while the pool has a free block of at
+   least ZERO_SPARE_ORDER to spare.  Pre-zeroed pages count as
+   allocated; when a pool runs out, they are given back before an
+   allocation fails. */
+
+/* Number of block orders.  The largest block is 2**10 pages,
+   4 MB, which is also the most that one allocation can get. */
+#define BUDDY_ORDERS 11
+
+/* Pre-zeroed page watermarks, per pool. */
+#define ZERO_LOW 8                      /* Wake kzerod below this. */
+#define ZERO_HIGH 32                    /* kzerod fills up to this. */
+
+/* kzerod only takes pages from a pool with a free block of this
+   order or larger, so that it never competes for the last pages. */
+#define ZERO_SPARE_ORDER 6
+
+/* State of a page, one byte per page.  A page that heads a free
+   block holds the block's order plus one instead. */
+#define PAGE_USED 0                     /* Allocated, or not memory. */
+#define PAGE_FREE 0xff                  /* Free, inside a free block. */
 
 /* A memory pool. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	size_t page_cnt;                /* Number of pages in pool. */
+	uint8_t *page_state;            /* State of each page. */
+	struct list free_blocks[BUDDY_ORDERS];  /* Free blocks by order. */
+	size_t free_cnt[BUDDY_ORDERS];  /* Length of each free list. */
+	void *zeroed[ZERO_HIGH];        /* Pre-zeroed pages. */
+	size_t zeroed_cnt;              /* Number of pages in ZEROED. */
+	size_t zero_reqs;               /* Single-page PAL_ZERO requests. */
+	size_t zero_hits;               /* ...served from ZEROED. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +91,16 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void print_pool_stats (const char *name, struct pool *);
+static void release_zeroed (struct pool *);
+static void zero_kick (void);
+static thread_func zero_thread;
+
+/* Wakes kzerod; ZERO_PENDING is true while it is up and not yet
+   taken.  ZERO_PENDING is only touched with interrupts off. */
+static struct semaphore zero_sema;
+static bool zero_pending;
 
 /* multiboot info */
 struct multiboot_info {
@@ -219,16 +278,16 @@ split:
 			else
 				NOT_REACHED ();
 
-			pool_end = pool->base + bitmap_size (pool->used_map) * PGSIZE;
+			pool_end = pool->base + pool->page_cnt * PGSIZE;
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_range (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_range (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -250,31 +309,173 @@ palloc_init (void) {
 	printf ("\text_mem: 0x%llx ~ 0x%llx (Usable: %'llu kB)\n",
 		  ext_mem.start, ext_mem.end, ext_mem.size / 1024);
 	populate_pools (&base_mem, &ext_mem);
+	sema_init (&zero_sema, 0);
 	return ext_mem.end;
 }
 
+/* Starts kzerod, which fills the pools' pre-zeroed pages.  Must
+   be called after thread_start(). */
+void
+palloc_zero_init (void) {
+	if (thread_create ("kzerod", PRI_MIN, zero_thread, NULL) == TID_ERROR)
+		PANIC ("could not start kzerod");
+	zero_kick ();
+}
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static int
+order_for (size_t page_cnt) {
+	int order = 0;
+
+	while (((size_t) 1 << order) < page_cnt)
+		order++;
+	return order;
+}
+
+/* Returns the address of the page at PAGE_IDX in POOL, through
+   which a free block at PAGE_IDX is linked into its free list. */
+static struct list_elem *
+block_elem (struct pool *pool, size_t page_idx) {
+	return (struct list_elem *) (pool->base + page_idx * PGSIZE);
+}
+
+/* Returns the index of the block that ELEM links into a free
+   list of POOL. */
+static size_t
+block_idx (struct pool *pool, struct list_elem *elem) {
+	return ((uint8_t *) elem - pool->base) / PGSIZE;
+}
+
+/* Puts the block of order ORDER at PAGE_IDX, whose pages must be
+   marked PAGE_FREE, on its free list. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order) {
+	pool->page_state[page_idx] = order + 1;
+	list_push_front (&pool->free_blocks[order], block_elem (pool, page_idx));
+	pool->free_cnt[order]++;
+}
+
+/* Takes the free block of order ORDER at PAGE_IDX off its free
+   list. */
+static void
+pull_block (struct pool *pool, size_t page_idx, int order) {
+	ASSERT (pool->page_state[page_idx] == order + 1);
+
+	pool->page_state[page_idx] = PAGE_FREE;
+	list_remove (block_elem (pool, page_idx));
+	pool->free_cnt[order]--;
+}
+
+/* Frees the block of order ORDER at PAGE_IDX, merging it with its
+   buddy as long as that is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order) {
+	memset (pool->page_state + page_idx, PAGE_FREE, (size_t) 1 << order);
+	while (order < BUDDY_ORDERS - 1) {
+		size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+		if (buddy + ((size_t) 1 << order) > pool->page_cnt
+				|| pool->page_state[buddy] != order + 1)
+			break;
+		pull_block (pool, buddy, order);
+		if (buddy < page_idx)
+			page_idx = buddy;
+		order++;
+	}
+	push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL, as a series of
+   blocks as large as their alignment allows. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order < BUDDY_ORDERS - 1
+				&& page_idx % ((size_t) 2 << order) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		free_block (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Takes PAGE_CNT contiguous free pages from POOL and returns the
+   index of the first, or SIZE_MAX if there is no free block large
+   enough. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt) {
+	int want = order_for (page_cnt);
+	int order;
+	size_t page_idx;
+
+	if (want >= BUDDY_ORDERS)
+		return SIZE_MAX;
+	for (order = want; order < BUDDY_ORDERS; order++)
+		if (!list_empty (&pool->free_blocks[order]))
+			break;
+	if (order == BUDDY_ORDERS)
+		return SIZE_MAX;
+
+	page_idx = block_idx (pool, list_front (&pool->free_blocks[order]));
+	pull_block (pool, page_idx, order);
+
+	/* Split down to the order wanted, freeing the upper halves. */
+	while (order > want) {
+		order--;
+		push_block (pool, page_idx + ((size_t) 1 << order), order);
+	}
+
+	/* Give back the pages past PAGE_CNT. */
+	memset (pool->page_state + page_idx, PAGE_USED, page_cnt);
+	free_range (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+	return page_idx;
+}
+
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   FLAGS, in which case the kernel panics.  At most 2**10 pages
+   can be obtained at once. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	bool want_zeroed = (flags & PAL_ZERO) && page_cnt == 1;
+	bool zeroed = false, kick = false;
+	void *pages = NULL;
 
 	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	if (want_zeroed) {
+		pool->zero_reqs++;
+		if (pool->zeroed_cnt > 0) {
+			pages = pool->zeroed[--pool->zeroed_cnt];
+			pool->zero_hits++;
+			zeroed = true;
+		}
+		kick = pool->zeroed_cnt < ZERO_LOW;
+	}
+	if (pages == NULL) {
+		size_t page_idx = alloc_pages (pool, page_cnt);
+
+		/* Rather than fail, give back the pre-zeroed pages. */
+		if (page_idx == SIZE_MAX && pool->zeroed_cnt > 0) {
+			release_zeroed (pool);
+			page_idx = alloc_pages (pool, page_cnt);
+		}
+		if (page_idx != SIZE_MAX)
+			pages = pool->base + PGSIZE * page_idx;
+	}
 	lock_release (&pool->lock);
-	void *pages;
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+	if (kick)
+		zero_kick ();
 
 	if (pages) {
-		if (flags & PAL_ZERO)
+		if ((flags & PAL_ZERO) && !zeroed)
 			memset (pages, 0, PGSIZE * page_cnt);
 	} else {
 		if (flags & PAL_ASSERT)
@@ -301,6 +502,9 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) {
 	struct pool *pool;
 	size_t page_idx;
+#ifndef NDEBUG
+	size_t i;
+#endif
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
@@ -318,8 +522,13 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
-	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	lock_acquire (&pool->lock);
+#ifndef NDEBUG
+	for (i = 0; i < page_cnt; i++)
+		ASSERT (pool->page_state[page_idx + i] == PAGE_USED);
+#endif
+	free_range (pool, page_idx, page_cnt);
+	lock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -328,21 +537,146 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	print_pool_stats ("Kernel", &kernel_pool);
+	print_pool_stats ("User", &user_pool);
+}
+
+/* Prints how many pages of POOL are free and how they are split
+   into blocks.  FRAG is the share of the free pages that lies in
+   blocks smaller than the largest order, which a request for the
+   largest possible block could not use. */
+static void
+print_pool_stats (const char *name, struct pool *pool) {
+	size_t free_pages = 0, frag;
+	int order;
+
+	lock_acquire (&pool->lock);
+	printf ("%s pool: free blocks by order:", name);
+	for (order = 0; order < BUDDY_ORDERS; order++) {
+		printf (" %zu", pool->free_cnt[order]);
+		free_pages += pool->free_cnt[order] << order;
+	}
+	frag = free_pages - (pool->free_cnt[BUDDY_ORDERS - 1] << (BUDDY_ORDERS - 1));
+	printf ("\n%s pool: %zu of %zu pages free, %zu%% fragmented\n",
+			name, free_pages, pool->page_cnt,
+			free_pages > 0 ? frag * 100 / free_pages : 0);
+	printf ("%s pool: %zu pages pre-zeroed, "
+			"%zu of %zu PAL_ZERO pages served pre-zeroed\n",
+			name, pool->zeroed_cnt, pool->zero_hits, pool->zero_reqs);
+	lock_release (&pool->lock);
+}
+
+/* Gives POOL's pre-zeroed pages back to its free lists.  POOL's
+   lock must be held. */
+static void
+release_zeroed (struct pool *pool) {
+	ASSERT (lock_held_by_current_thread (&pool->lock));
+
+	while (pool->zeroed_cnt > 0) {
+		void *page = pool->zeroed[--pool->zeroed_cnt];
+		free_range (pool, pg_no (page) - pg_no (pool->base), 1);
+	}
+}
+
+/* Returns true if POOL, whose lock must be held, has a free block
+   of ZERO_SPARE_ORDER or larger. */
+static bool
+pool_has_spare (struct pool *pool) {
+	int order;
+
+	for (order = ZERO_SPARE_ORDER; order < BUDDY_ORDERS; order++)
+		if (pool->free_cnt[order] > 0)
+			return true;
+	return false;
+}
+
+/* Fills POOL's pre-zeroed pages up to ZERO_HIGH, clearing each
+   page without holding the pool's lock. */
+static void
+refill_zeroed (struct pool *pool) {
+	for (;;) {
+		size_t page_idx;
+		void *page;
+
+		lock_acquire (&pool->lock);
+		if (pool->zeroed_cnt >= ZERO_HIGH || !pool_has_spare (pool)) {
+			lock_release (&pool->lock);
+			return;
+		}
+		page_idx = alloc_pages (pool, 1);
+		lock_release (&pool->lock);
+		ASSERT (page_idx != SIZE_MAX);
+
+		page = pool->base + PGSIZE * page_idx;
+		memset (page, 0, PGSIZE);
+
+		/* Only kzerod adds pages, so there is still room. */
+		lock_acquire (&pool->lock);
+		ASSERT (pool->zeroed_cnt < ZERO_HIGH);
+		pool->zeroed[pool->zeroed_cnt++] = page;
+		lock_release (&pool->lock);
+	}
+}
+
+/* Wakes kzerod, unless it has already been woken and has not yet
+   run.  Before palloc_zero_init(), this just leaves it pending. */
+static void
+zero_kick (void) {
+	enum intr_level old_level = intr_disable ();
+
+	if (!zero_pending) {
+		zero_pending = true;
+		sema_up (&zero_sema);
+	}
+	intr_set_level (old_level);
+}
+
+/* kzerod: refills both pools' pre-zeroed pages each time it is
+   woken. */
+static void
+zero_thread (void *aux UNUSED) {
+	if (thread_mlfqs)
+		thread_set_nice (NICE_MAX);
+
+	for (;;) {
+		enum intr_level old_level;
+
+		sema_down (&zero_sema);
+		old_level = intr_disable ();
+		zero_pending = false;
+		intr_set_level (old_level);
+
+		refill_zeroed (&kernel_pool);
+		refill_zeroed (&user_pool);
+	}
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's page states at its base.
+     Calculate the space needed for them
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t bm_pages = DIV_ROUND_UP (pgcnt, PGSIZE) * PGSIZE;
+	int order;
 
 	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
+	p->page_cnt = pgcnt;
+	p->page_state = *bm_base;
+	for (order = 0; order < BUDDY_ORDERS; order++) {
+		list_init (&p->free_blocks[order]);
+		p->free_cnt[order] = 0;
+	}
+	p->zeroed_cnt = 0;
+	p->zero_reqs = p->zero_hits = 0;
 
 	// Mark all to unusable.
-	bitmap_set_all(p->used_map, true);
+	memset (p->page_state, PAGE_USED, pgcnt);
 
 	*bm_base += bm_pages;
 }
@@ -353,6 +687,6 @@ static bool
 page_from_pool (const struct pool *pool, void *page) {
 	size_t page_no = pg_no (page);
 	size_t start_page = pg_no (pool->base);
-	size_t end_page = start_page + bitmap_size (pool->used_map);
+	size_t end_page = start_page + pool->page_cnt;
 	return page_no >= start_page && page_no < end_page;
 }
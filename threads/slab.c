@@ -0,0 +1,303 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Each slab is one page.  The page starts with a struct slab and
+   its free list, which is an array of object indexes rather than
+   pointers stored in the free objects, since free objects keep
+   their constructed contents.  The objects follow, shifted by
+   the slab's color:
+
+      +------------+---------+-------+-----+-----+-----+---------+
+      | struct slab| next [] | color | obj | obj | ... |  slack  |
+      +------------+---------+-------+-----+-----+-----+---------+
+
+   Color plus slack is the same for every slab of a cache. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab0bec
+
+/* Objects are aligned to this many bytes. */
+#define SLAB_ALIGN sizeof (void *)
+
+/* Colors step by a cache line if the slack allows it. */
+#define CACHE_LINE 64
+
+/* Empty slabs a cache keeps before giving pages back. */
+#define SLAB_EMPTY_MAX 1
+
+/* Ends a slab's free list. */
+#define SLAB_END UINT16_MAX
+
+/* Object cache. */
+struct kmem_cache {
+	const char *name;           /* Name, for statistics. */
+	size_t obj_size;            /* Object size, multiple of SLAB_ALIGN. */
+	size_t obj_cnt;             /* Objects per slab. */
+	size_t hdr_size;            /* Bytes before the first color. */
+	size_t color_step;          /* Distance between colors. */
+	size_t color_max;           /* Largest color. */
+	size_t color_next;          /* Color of the next new slab. */
+	kmem_ctor_func *ctor;       /* Constructor, or null. */
+
+	struct lock lock;           /* Protects everything below. */
+	struct list partial;        /* Slabs with used and free objects. */
+	struct list full;           /* Slabs with no free objects. */
+	struct list empty;          /* Slabs with no used objects. */
+	size_t empty_cnt;           /* Length of EMPTY. */
+	size_t slab_cnt;            /* Slabs on all three lists. */
+	size_t in_use;              /* Objects allocated. */
+	size_t peak;                /* Largest IN_USE so far. */
+
+	struct list_elem elem;      /* Element in all_caches. */
+};
+
+/* Slab header, at the start of each slab's page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in one of CACHE's lists. */
+	uint8_t *objs;              /* First object. */
+	size_t in_use;              /* Objects allocated. */
+	uint16_t free;              /* First free object, or SLAB_END. */
+	uint16_t next[];            /* Next free object after each one. */
+};
+
+/* The cache that struct kmem_caches come from. */
+static struct kmem_cache cache_cache;
+
+/* Every cache, for kmem_cache_print_stats(). */
+static struct list all_caches;
+static struct lock all_caches_lock;
+
+static void cache_init (struct kmem_cache *, const char *name,
+		size_t size, kmem_ctor_func *);
+static struct slab *slab_create (struct kmem_cache *);
+static struct slab *obj_to_slab (void *);
+
+/* Initializes the slab allocator. */
+void
+slab_init (void) {
+	list_init (&all_caches);
+	lock_init (&all_caches_lock);
+	cache_init (&cache_cache, "kmem_cache", sizeof (struct kmem_cache),
+			NULL);
+}
+
+/* Creates and returns a cache of SIZE-byte objects called NAME,
+   which must stay valid as long as the cache, and which are set
+   up by CTOR, if it is nonnull, when their slab is created.
+   Panics if memory is not available, since caches are meant to
+   be created when the kernel starts. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor) {
+	struct kmem_cache *c = kmem_cache_alloc (&cache_cache);
+
+	if (c == NULL)
+		PANIC ("out of memory creating %s cache", name);
+	cache_init (c, name, size, ctor);
+	return c;
+}
+
+/* Obtains and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	void *obj;
+
+	lock_acquire (&c->lock);
+
+	/* Prefer a partial slab, so that the others can empty out. */
+	if (!list_empty (&c->partial))
+		s = list_entry (list_front (&c->partial), struct slab, elem);
+	else {
+		if (!list_empty (&c->empty)) {
+			s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+			c->empty_cnt--;
+		} else {
+			s = slab_create (c);
+			if (s == NULL) {
+				lock_release (&c->lock);
+				return NULL;
+			}
+		}
+		list_push_front (&c->partial, &s->elem);
+	}
+
+	/* Take its first free object. */
+	ASSERT (s->free != SLAB_END);
+	obj = s->objs + s->free * c->obj_size;
+	s->free = s->next[s->free];
+	if (++s->in_use == c->obj_cnt) {
+		list_remove (&s->elem);
+		list_push_front (&c->full, &s->elem);
+	}
+	if (++c->in_use > c->peak)
+		c->peak = c->in_use;
+
+	lock_release (&c->lock);
+	return obj;
+}
+
+/* Gives OBJ, which must have come from cache C, back to C.  Does
+   nothing if OBJ is null. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct slab *s;
+	size_t idx;
+
+	if (obj == NULL)
+		return;
+
+	s = obj_to_slab (obj);
+	ASSERT (s->cache == c);
+	idx = ((uint8_t *) obj - s->objs) / c->obj_size;
+	ASSERT (s->objs + idx * c->obj_size == obj);
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs, unless
+	   its constructed state has to survive. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->obj_size);
+#endif
+
+	lock_acquire (&c->lock);
+
+	if (s->in_use-- == c->obj_cnt) {
+		list_remove (&s->elem);
+		list_push_front (&c->partial, &s->elem);
+	}
+	s->next[idx] = s->free;
+	s->free = idx;
+	c->in_use--;
+
+	/* If the slab is now unused, keep it, or give its page back if
+	   the cache already has enough empty slabs. */
+	if (s->in_use == 0) {
+		list_remove (&s->elem);
+		if (c->empty_cnt < SLAB_EMPTY_MAX) {
+			list_push_front (&c->empty, &s->elem);
+			c->empty_cnt++;
+		} else {
+			c->slab_cnt--;
+			palloc_free_page (s);
+		}
+	}
+
+	lock_release (&c->lock);
+}
+
+/* Prints, for each cache, how many objects are in use and how
+   much of the cache's slab memory they fill. */
+void
+kmem_cache_print_stats (void) {
+	struct list_elem *e;
+
+	lock_acquire (&all_caches_lock);
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		size_t bytes;
+
+		lock_acquire (&c->lock);
+		bytes = c->slab_cnt * PGSIZE;
+		printf ("%s cache: %zu-byte objects, %zu in use (peak %zu), "
+				"%zu slabs, %zu%% used\n",
+				c->name, c->obj_size, c->in_use, c->peak, c->slab_cnt,
+				bytes > 0 ? c->in_use * c->obj_size * 100 / bytes : 0);
+		lock_release (&c->lock);
+	}
+	lock_release (&all_caches_lock);
+}
+
+/* Initializes C as an empty cache of SIZE-byte objects called
+   NAME with constructor CTOR, and adds it to all_caches. */
+static void
+cache_init (struct kmem_cache *c, const char *name, size_t size,
+		kmem_ctor_func *ctor) {
+	size_t slack;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0);
+
+	c->name = name;
+	c->obj_size = ROUND_UP (size, SLAB_ALIGN);
+	c->obj_cnt = (PGSIZE - sizeof (struct slab) - (SLAB_ALIGN - 1))
+		/ (c->obj_size + sizeof (uint16_t));
+	ASSERT (c->obj_cnt > 0);
+	if (c->obj_cnt > SLAB_END)
+		c->obj_cnt = SLAB_END;
+	c->hdr_size = ROUND_UP (sizeof (struct slab)
+			+ c->obj_cnt * sizeof (uint16_t), SLAB_ALIGN);
+
+	/* Spread the slack at the end of the page over the colors. */
+	slack = PGSIZE - c->hdr_size - c->obj_cnt * c->obj_size;
+	c->color_step = slack >= CACHE_LINE ? CACHE_LINE : SLAB_ALIGN;
+	c->color_max = slack / c->color_step * c->color_step;
+	c->color_next = 0;
+	c->ctor = ctor;
+
+	lock_init (&c->lock);
+	list_init (&c->partial);
+	list_init (&c->full);
+	list_init (&c->empty);
+	c->empty_cnt = 0;
+	c->slab_cnt = 0;
+	c->in_use = 0;
+	c->peak = 0;
+
+	lock_acquire (&all_caches_lock);
+	list_push_back (&all_caches, &c->elem);
+	lock_release (&all_caches_lock);
+}
+
+/* Allocates a new slab for cache C, which must be locked, and
+   constructs its objects.  Returns a null pointer if memory is
+   not available. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s;
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&c->lock));
+
+	s = palloc_get_page (0);
+	if (s == NULL)
+		return NULL;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->objs = (uint8_t *) s + c->hdr_size + c->color_next;
+	s->in_use = 0;
+	c->color_next += c->color_step;
+	if (c->color_next > c->color_max)
+		c->color_next = 0;
+
+	for (i = 0; i < c->obj_cnt; i++) {
+		s->next[i] = i + 1 < c->obj_cnt ? i + 1 : SLAB_END;
+		if (c->ctor != NULL)
+			c->ctor (s->objs + i * c->obj_size);
+	}
+	s->free = 0;
+	c->slab_cnt++;
+	return s;
+}
+
+/* Returns the slab that OBJ is inside. */
+static struct slab *
+obj_to_slab (void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	ASSERT (s != NULL);
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT ((uint8_t *) obj >= s->objs);
+	return s;
+}
@@ -27,44 +27,56 @@
    */
 
 #include "threads/synch.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
-/* One semaphore in a list. */
+/* One semaphore in a condition variable's waiters heap. */
 // 현재 스레드가 사용할 "자기 전용 이진 세마포어".
 struct semaphore_elem {
-	// 참고: elem의 멤버는 struct list_elem *prev, *next;
-	struct list_elem elem;              /* List element. */
+	struct heap_elem elem;              /* Heap element. */
 	struct semaphore semaphore;         /* This semaphore. */
+	struct thread *thread;              /* Waiting thread. */
+	int priority;                       /* Waiter's priority when queued. */
+	unsigned long long seq;             /* FIFO order among equals. */
 };
 
-
-// 두 sema의 'waiters list내 스레드 중 제일 높은 priority'를 비교
-// a가 높으면 true, b가 높으면 false.
-bool sema_priority_cmp(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
-{
-	struct semaphore_elem *sema_a = list_entry(a, struct semaphore_elem, elem);
-	struct semaphore_elem *sema_b = list_entry(b, struct semaphore_elem, elem);
-
-	struct list *waiters_a = &(sema_a->semaphore.waiters);
-	struct list *waiters_b = &(sema_b->semaphore.waiters);
-
-	struct thread *root_a = list_entry(list_begin(waiters_a), struct thread, elem);
-	struct thread *root_b = list_entry(list_begin(waiters_b), struct thread, elem);
-
-	return root_a->priority > root_b->priority;
+/* Returns the semaphore_elem that SEMA is embedded in. */
+#define sema_elem_of(SEMA) \
+	((struct semaphore_elem *) ((uint8_t *) (SEMA) \
+		- offsetof (struct semaphore_elem, semaphore)))
+
+/* Next sequence number for a waiter.  Waiters of equal priority
+   are woken in the order of their sequence numbers, i.e. FIFO. */
+static unsigned long long waiter_seq;
+
+// semaphore waiters heap의 순서: priority가 높은 스레드가 먼저, 같으면 먼저 온 스레드가 먼저.
+// a가 먼저면 true.
+static bool
+sema_waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = heap_entry (a_, struct thread, wait_elem);
+	const struct thread *b = heap_entry (b_, struct thread, wait_elem);
+
+	if (a->priority != b->priority)
+		return a->priority > b->priority;
+	return a->wait_seq < b->wait_seq;
 }
 
-// donation_elem의 priority를 기준으로 비교
-// a가 높으면 true, b가 높으면 false.
-bool donation_priority_cmp(const struct list_elem *a,
-						   const struct list_elem *b, void *aux UNUSED)
-{
-	struct thread *st_a = list_entry(a, struct thread, donation_elem);
-	struct thread *st_b = list_entry(b, struct thread, donation_elem);
-	return st_a->priority > st_b->priority;
+// condition waiters heap의 순서: 각 세마포어를 기다리는 스레드의 priority 기준.
+// 스레드는 큐에 들어간 직후 아직 실행 중일 수 있으므로 (lock_release 중 priority가 바뀜)
+// 큐에 들어갈 때의 priority를 semaphore_elem에 저장해 두고 그것으로 비교.
+static bool
+cond_waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct semaphore_elem *a = heap_entry (a_, struct semaphore_elem, elem);
+	const struct semaphore_elem *b = heap_entry (b_, struct semaphore_elem, elem);
+
+	if (a->priority != b->priority)
+		return a->priority > b->priority;
+	return a->seq < b->seq;
 }
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
@@ -81,7 +93,7 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	heap_init (&sema->waiters, sema_waiter_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -114,10 +126,16 @@ sema_down (struct semaphore *sema) {
 
 	old_level = intr_disable ();
 	while (sema->value == 0) {
+		struct thread *cur = thread_current ();
+
 		/*-- Priority donation 과제 --*/
-		// 현재 스레드를 priority 높은 순으로 waiters 리스트에 삽입
-		list_insert_ordered(&sema->waiters, &thread_current()->elem, thread_priority_cmp, NULL);
-		// list_push_back (&sema->waiters, &thread_current ()->elem); 이건 기존꺼.
+		// 현재 스레드를 waiters heap에 삽입 (O(log n)). priority가 바뀌면 sema_waiter_set_priority()가 재배치.
+		cur->wait_sema = sema;
+		cur->wait_seq = waiter_seq++;
+		heap_push (&sema->waiters, &cur->wait_elem);
+		// 락을 얻으려고 기다리는 중이면 holder 체인을 따라 priority 기부 (MLFQS에서는 기부 없음)
+		if (!thread_mlfqs)
+			donate_priority_from (cur);
 		/*-- Priority donation 과제 --*/
 		thread_block ();
 	}
@@ -161,15 +179,16 @@ sema_up (struct semaphore *sema) {
 	ASSERT (sema != NULL);
 
 	old_level = intr_disable ();
-	if (!list_empty (&sema->waiters)){
+	if (!heap_empty (&sema->waiters)){
 
 	/*-- Priority donation 과제 --*/
 		/* Priority donation 과제
-		   waiters 리스트를 priority 기준으로 정렬하여 가장 높은 priority 스레드를 먼저 깨우도록 함.
-		*/	
-		list_sort(&sema->waiters, thread_priority_cmp, NULL);
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem));
+		   waiters heap의 top이 가장 높은 priority 스레드이므로 정렬 없이 바로 깨움.
+		*/
+		struct thread *t = heap_entry (heap_pop (&sema->waiters),
+				struct thread, wait_elem);
+		t->wait_sema = NULL;
+		thread_unblock (t);
 	}
 	sema->value++;
 
@@ -179,6 +198,39 @@ sema_up (struct semaphore *sema) {
 	intr_set_level (old_level);
 }
 
+/* Sets the priority of T, which must be blocked, to PRIORITY.  If
+   T is waiting on a semaphore, and possibly on a condition
+   variable through it, T is moved to its new place among the
+   waiters, behind those of equal priority.
+
+   Must be called with interrupts off. */
+void
+sema_waiter_set_priority (struct thread *t, int priority) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->status == THREAD_BLOCKED);
+
+	if (t->wait_sema == NULL) {
+		t->priority = priority;
+		return;
+	}
+
+	heap_remove (&t->wait_sema->waiters, &t->wait_elem);
+	t->priority = priority;
+	t->wait_seq = waiter_seq++;
+	heap_push (&t->wait_sema->waiters, &t->wait_elem);
+
+	/* A thread waiting on a condition variable is blocked on its
+	   own semaphore_elem's semaphore. */
+	if (t->wait_cond != NULL) {
+		struct semaphore_elem *waiter = sema_elem_of (t->wait_sema);
+
+		heap_remove (&t->wait_cond->waiters, &waiter->elem);
+		waiter->priority = priority;
+		waiter->seq = waiter_seq++;
+		heap_push (&t->wait_cond->waiters, &waiter->elem);
+	}
+}
+
 static void sema_test_helper (void *sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -245,7 +297,42 @@ lock_init (struct lock *lock) {
 	ASSERT (lock != NULL);
 
 	lock->holder = NULL;
-	sema_init (&lock->semaphore, 1);
+	sema_init (&lock->semaphore, 0);
+	lock->hold.priority = PRI_MIN;
+}
+
+/* Makes the running thread LOCK's holder, if LOCK is free.  The
+   holder field is the lock word: a lock is held exactly when it
+   is non-null. */
+static bool
+lock_claim (struct lock *lock) {
+	struct thread *free = NULL;
+
+	return __atomic_compare_exchange_n (&lock->holder, &free,
+			thread_current (), false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Fast path of lock_acquire() and lock_try_acquire(): takes LOCK
+   if it is free.  Interrupt handlers never take or release locks,
+   so claiming the holder needs only preemption disabled.
+   Recording the hold does need interrupts off, because it reads
+   the waiters of LOCK's semaphore, which may still hold a woken
+   waiter, and under -mlfqs the timer interrupt re-sorts blocked
+   waiters when it recomputes their priorities.  Returns false,
+   having changed nothing, if LOCK is taken. */
+static bool
+lock_fast_acquire (struct lock *lock) {
+	bool success;
+
+	preempt_disable ();
+	success = lock_claim (lock);
+	if (success) {
+		enum intr_level old_level = intr_disable ();
+		add_held_lock (lock);
+		intr_set_level (old_level);
+	}
+	preempt_enable ();
+	return success;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -258,30 +345,29 @@ lock_init (struct lock *lock) {
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	if (lock_fast_acquire (lock))
+		return;
 
-	/*-- Priority donation 과제 --*/
-    struct thread *t = thread_current();
-    if (lock->holder != NULL) {
-        t->wait_lock = lock;
-
-		/*-- Priority CondVar 과제 --*/
-		list_insert_ordered(&lock->holder->donations, &t->donation_elem, donation_priority_cmp, NULL);
-		/*-- Priority CondVar 과제 --*/
-
-        donate_priority();
-    }
-	/*-- Priority donation 과제 --*/
-
-	sema_down (&lock->semaphore);
+	old_level = intr_disable ();
 
 	/*-- Priority donation 과제 --*/
+	// wait_lock을 설정해 두면 sema_down()이 waiters heap에 들어간 직후 holder 체인에 priority를 기부함.
+	// 세마포어는 대기열로만 쓰고(값은 0), 깨어나면 holder를 다시 CAS로 잡아 봄.
+	t->wait_lock = lock;
+	while (!lock_claim (lock))
+		sema_down (&lock->semaphore);
 	t->wait_lock = NULL;
-	lock->holder = thread_current();
+	add_held_lock (lock); // 남은 waiters의 priority를 이어받음
 	/*-- Priority donation 과제 --*/
+
+	intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -292,15 +378,10 @@ lock_acquire (struct lock *lock) {
    interrupt handler. */
 bool
 lock_try_acquire (struct lock *lock) {
-	bool success;
-
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	success = sema_try_down (&lock->semaphore);
-	if (success)
-		lock->holder = thread_current ();
-	return success;
+	return lock_fast_acquire (lock);
 }
 
 /* Releases LOCK, which must be owned by the current thread.
@@ -313,14 +394,25 @@ void
 lock_release (struct lock *lock) {
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
-	
+
+	/* A thread joins LOCK's waiters only after failing to claim
+	   the holder with interrupts off, and no other thread runs
+	   while preemption is disabled here, so none can join between
+	   clearing the holder and looking for waiters, and no wakeup
+	   is lost.  That holds only because the kernel runs on one
+	   CPU.  A waiter woken here gets the CPU, if it should, at
+	   preempt_enable(). */
+	preempt_disable ();
+
 	/*-- Priority donation 과제 --*/
-    remove_with_lock(lock);
-    refresh_priority();
+	// 이 락을 통해 받던 기부만 빠짐: held_locks heap에서 제거 후 priority 재계산 (O(log n))
+	remove_held_lock (lock);
 	/*-- Priority donation 과제 --*/
 
-	lock->holder = NULL;
-	sema_up (&lock->semaphore);
+	__atomic_store_n (&lock->holder, NULL, __ATOMIC_RELEASE);
+	if (!heap_empty (&lock->semaphore.waiters))
+		sema_up (&lock->semaphore);
+	preempt_enable ();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -333,6 +425,145 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
+/* Initializes reader-writer lock RW.  RW may be held for reading
+   by any number of threads at once, or for writing by a single
+   thread.
+
+   Like a lock, RW has owners, and a thread that waits for RW
+   donates its priority to all of them: to the writer, or to every
+   reader.  Writers are preferred over readers: a thread that asks
+   to read waits while any writer holds or waits for RW, and a
+   releasing writer hands RW to the next writer before letting
+   the waiting readers in.  Neither kind of hold is recursive. */
+void
+rw_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	rw->writer = NULL;
+	rw->readers = 0;
+	rw->writers_waiting = 0;
+	sema_init (&rw->read_sema, 0);
+	sema_init (&rw->write_sema, 0);
+	rw->write_hold.priority = PRI_MIN;
+	list_init (&rw->read_holds);
+}
+
+/* Acquires RW for reading, sleeping until no writer holds or is
+   waiting for it.  The current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_read_acquire (struct rwlock *rw) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer != t);
+	ASSERT (!rw_read_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	// writer 우선: writer가 잡고 있거나 기다리는 중이면 새 reader는 대기.
+	t->wait_rwlock = rw;
+	while (rw->writer != NULL || rw->writers_waiting > 0)
+		sema_down (&rw->read_sema);
+	t->wait_rwlock = NULL;
+	rw->readers++;
+	add_held_rwlock (rw, false);
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rw_read_release (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rw_read_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	remove_held_rwlock (rw, false);
+	if (--rw->readers == 0 && !heap_empty (&rw->write_sema.waiters))
+		sema_up (&rw->write_sema);
+	check_and_preempt ();  // 기부받던 priority가 빠졌을 수 있음
+	intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  The current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_write_acquire (struct rwlock *rw) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer != t);
+	ASSERT (!rw_read_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	// 기다리는 동안에도 writers_waiting에 포함되어 새 reader를 막음.
+	rw->writers_waiting++;
+	t->wait_rwlock = rw;
+	while (rw->writer != NULL || rw->readers > 0)
+		sema_down (&rw->write_sema);
+	t->wait_rwlock = NULL;
+	rw->writers_waiting--;
+	rw->writer = t;
+	add_held_rwlock (rw, true);
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread holds for writing.  The
+   highest-priority waiting writer goes next; if there is none,
+   all waiting readers are woken. */
+void
+rw_write_release (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rw_write_held_by_current_thread (rw));
+
+	old_level = intr_disable ();
+	remove_held_rwlock (rw, true);
+	rw->writer = NULL;
+	if (!heap_empty (&rw->write_sema.waiters))
+		sema_up (&rw->write_sema);
+	else if (rw->writers_waiting == 0)
+		while (!heap_empty (&rw->read_sema.waiters))
+			sema_up (&rw->read_sema);
+	check_and_preempt ();  // 기부받던 priority가 빠졌을 수 있음
+	intr_set_level (old_level);
+}
+
+/* Returns true if the current thread holds RW for reading, false
+   otherwise. */
+bool
+rw_read_held_by_current_thread (const struct rwlock *rw) {
+	struct thread *cur = thread_current ();
+	int i;
+
+	ASSERT (rw != NULL);
+
+	for (i = 0; i < RW_READ_HOLD_MAX; i++)
+		if (cur->read_holds[i].rwlock == rw)
+			return true;
+	return false;
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rw_write_held_by_current_thread (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return rw->writer == thread_current ();
+}
+
 
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
@@ -341,7 +572,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	heap_init (&cond->waiters, cond_waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -370,6 +601,8 @@ cond_wait (struct condition *cond, struct lock *lock) {
 	// 설명: 컨디션 변수용 세마포어 선언.
 	// 현재 스레드가 사용할 "자기 전용 이진 세마포어".
 	struct semaphore_elem waiter;
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
@@ -381,9 +614,15 @@ cond_wait (struct condition *cond, struct lock *lock) {
 	sema_init (&waiter.semaphore, 0); 
 
 	/*-- Priority CondVar 과제 --*/
-	// list_push_back (&cond->waiters, &waiter.elem);
-	// 특정한 공유 자원(&cond)의 리스트(->waiters)에, 이 스레드의 elem을, sema_priority_cmp 순서에 의하여 추가.
-	list_insert_ordered(&cond->waiters, &waiter.elem, sema_priority_cmp, NULL);
+	// 특정한 공유 자원(&cond)의 waiters heap에, 이 스레드의 세마포어를 현재 priority로 추가.
+	// MLFQS는 타이머 인터럽트에서 priority를 바꾸므로 heap 조작은 인터럽트를 끄고 함.
+	old_level = intr_disable ();
+	waiter.thread = cur;
+	waiter.priority = cur->priority;
+	waiter.seq = waiter_seq++;
+	cur->wait_cond = cond;
+	heap_push (&cond->waiters, &waiter.elem);
+	intr_set_level (old_level);
 	/*-- Priority CondVar 과제 --*/
 
 	lock_release (lock);
@@ -400,20 +639,28 @@ cond_wait (struct condition *cond, struct lock *lock) {
    interrupt handler. */
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) {
+	struct semaphore_elem *waiter = NULL;
+	enum intr_level old_level;
+
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters)){// 즉, 대기 중인 (잠든) 스레드가 존재한다면,
+	old_level = intr_disable ();
+	if (!heap_empty (&cond->waiters)){// 즉, 대기 중인 (잠든) 스레드가 존재한다면,
 
 		/*-- Priority CondVar 과제 --*/
-		list_sort(&cond->waiters, sema_priority_cmp, NULL); // 우선순위가 가장 높은 스레드가 들어 있는 세마포어를 찾기 위함
+		// heap의 top이 우선순위가 가장 높은 스레드가 기다리는 세마포어.
+		waiter = heap_entry (heap_pop (&cond->waiters),
+				struct semaphore_elem, elem);
 		/*-- Priority CondVar 과제 --*/
-
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
+		waiter->thread->wait_cond = NULL;
 	}
+	intr_set_level (old_level);
+
+	if (waiter != NULL)
+		sema_up (&waiter->semaphore);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -428,7 +675,7 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!heap_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
 
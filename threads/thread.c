@@ -7,7 +7,10 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/seqlock.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
@@ -24,9 +27,14 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO queue
+   per priority level, and bit P of ready_mask is set if and only
+   if ready_queues[P] is nonempty, so the highest-priority ready
+   thread is found with a single bit scan. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
+static int ready_cnt;           /* # of threads in the ready queues. */
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -34,16 +42,35 @@ static struct thread *idle_thread;
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+/* All live threads, hashed by tid.  Tids are handed out in
+   sequence, so taking the low bits spreads them evenly over the
+   buckets.  Accessed with interrupts off. */
+#define TID_TABLE_BITS 8
+#define TID_TABLE_SIZE (1 << TID_TABLE_BITS)
+static struct list tid_table[TID_TABLE_SIZE];
 
 /* Thread destruction requests */
 static struct list destruction_req;
 
+/* Pages of exited threads kept for reuse by thread_alloc(), most
+   recently freed first, linked through their dead struct
+   thread's `elem'.  A recycled page skips the trip through the
+   page allocator and the zeroing of the whole page: init_thread()
+   resets the struct thread header, and nothing reads the stack
+   before writing it.  do_schedule() adds every dead thread's
+   page here, since it runs with interrupts off and must not call
+   palloc_free_page(), which may block on the pool lock.  Pages
+   beyond THREAD_CACHE_MAX go back to palloc later, from
+   thread_cache_trim().  Accessed with interrupts off. */
+#define THREAD_CACHE_MAX 16
+static struct list thread_cache;
+static size_t thread_cache_cnt;
+
 /* Statistics. */
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
+static struct seqlock stats_seq = SEQLOCK_INITIALIZER;
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
@@ -54,11 +81,54 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
-/* sleep_lock for sleeping threads. */
-// static struct lock sleep_lock;
-
-/* List of sleeping threads. */
-static struct list sleep_list;
+/* Multi-level feedback queue scheduler state.
+
+   load_avg and the recent_cpu of every runnable thread are
+   recomputed once per second.  Blocked threads are skipped: the
+   per-second decay coefficient is kept in decay_hist[], and a
+   blocked thread's recent_cpu catches up on those seconds when
+   it wakes, so a tick never costs time proportional to the
+   number of sleeping threads.  Priorities are recomputed every
+   MLFQS_PRI_INTERVAL ticks, only for the threads on
+   mlfqs_dirty_list, i.e. those whose recent_cpu changed. */
+#define MLFQS_PRI_INTERVAL 4    /* # of ticks between priority updates. */
+#define DECAY_HIST 64           /* # of seconds of decay history kept. */
+static fixed_t load_avg;        /* System load average. */
+static int64_t mlfqs_seconds;   /* # of per-second updates done. */
+static fixed_t decay_hist[DECAY_HIST];  /* Decay coefficient of each second. */
+static struct list mlfqs_dirty_list;    /* Threads needing a new priority. */
+
+/* If true, use the stride scheduler.
+   Controlled by kernel command-line option "-stride". */
+bool thread_stride;
+
+/* Stride scheduler state.
+
+   Each thread's stride is STRIDE1 divided by its tickets, and its
+   pass advances by its stride for every tick it runs.  The ready
+   thread with the smallest pass runs next, so over time every
+   thread receives CPU time in proportion to its tickets.  Ready
+   threads are kept in a min-heap ordered by pass; stride_pass is
+   the pass of the thread dispatched last, which a waking thread
+   catches up to so that it cannot build up credit while
+   blocked. */
+#define STRIDE1 (1 << 20)       /* Stride of a thread with one ticket. */
+static struct heap stride_queue;
+static int64_t stride_pass;
+
+/* Real-time threads, scheduled earliest deadline first.
+
+   A real-time thread may use up to rt_budget ticks of CPU time in
+   every rt_period ticks.  Ready real-time threads sit in rt_queue,
+   ordered by the end of their current period, and always run
+   before any thread in the normal ready queues.  A thread that
+   uses up its budget is throttled: it is left out of rt_queue
+   until its period timer starts the next period.  A deadline is
+   missed if a period ends while the thread is still runnable and
+   has budget left, i.e. it wanted CPU time it did not get. */
+static struct heap rt_queue;
+static struct list rt_threads;  /* All live real-time threads. */
+static long long rt_exited_misses;      /* Misses of exited RT threads. */
 
 
 static void kernel_thread (thread_func *, void *aux);
@@ -69,6 +139,25 @@ static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
+static void tid_table_insert (struct thread *);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (void);
+static void set_priority (struct thread *, int priority);
+static void thread_wakeup (void *t_);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_catch_up (struct thread *);
+static bool stride_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+static bool rt_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+static void rt_period_start (void *t_);
+static struct thread *thread_alloc (const char *name, int priority,
+		thread_func *, void *aux);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
+static void thread_cache_trim (void);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -86,26 +175,6 @@ static tid_t allocate_tid (void);
 // setup temporal gdt first.
 static uint64_t gdt[3] = { 0, 0x00af9a000000ffff, 0x00cf92000000ffff };
 
-/* Compares the wakeup_tick of two threads A and B.
-   A가 작으면 true, B가 작으면 false. */
-bool thread_wakeup_tick_cmp(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
-	const struct thread *thread_a = list_entry(a, struct thread, elem);
-	const struct thread *thread_b = list_entry(b, struct thread, elem);
-	return thread_a->wakeup_tick < thread_b->wakeup_tick;
-}
-
-/* Compares the priority of two threads A and B.
-   A가 크면 true, B가 크면 false. */
-bool thread_priority_cmp(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
-    struct thread*thread_a = list_entry(a, struct thread, elem);
-    struct thread*thread_b = list_entry(b, struct thread, elem);
-
-	if (thread_a == NULL || thread_b == NULL)
-		return false;
-
-    return thread_a->priority > thread_b->priority;
-}
-
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
@@ -133,16 +202,27 @@ thread_init (void) {
 	lgdt (&gdt_ds);
 
 	/* Init the globla thread context */
-	lock_init (&tid_lock);
-	list_init (&ready_list);
+	for (int i = 0; i < TID_TABLE_SIZE; i++)
+		list_init (&tid_table[i]);
+	for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+		list_init (&ready_queues[pri]);
+	ready_mask = 0;
+	ready_cnt = 0;
 	list_init (&destruction_req);
-	list_init (&sleep_list); /** Alarm Clock 과제 */
+	list_init (&thread_cache);
+	thread_cache_cnt = 0;
+	list_init (&mlfqs_dirty_list);
+	heap_init (&stride_queue, stride_less, NULL);
+	stride_pass = 0;
+	heap_init (&rt_queue, rt_less, NULL);
+	list_init (&rt_threads);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
+	tid_table_insert (initial_thread);
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -166,8 +246,10 @@ thread_start (void) {
 void
 thread_tick (void) {
 	struct thread *t = thread_current ();
+	enum intr_level old_level;
 
 	/* Update statistics. */
+	old_level = seqlock_write_lock (&stats_seq);
 	if (t == idle_thread)
 		idle_ticks++;
 #ifdef USERPROG
@@ -176,17 +258,62 @@ thread_tick (void) {
 #endif
 	else
 		kernel_ticks++;
+	seqlock_write_unlock (&stats_seq, old_level);
+
+	if (thread_mlfqs)
+		mlfqs_tick (t);
+	else if (thread_stride && t != idle_thread)
+		t->pass += t->stride;
+
+	/* Charge a real-time thread against its budget. */
+	if (t->rt && --t->rt_remaining <= 0) {
+		t->rt_throttled = true;
+		intr_yield_on_return ();
+	}
 
 	/* Enforce preemption. */
 	if (++thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
 }
 
+/* Credits TICKS timer ticks that went by without a timer
+   interrupt to the idle thread.  Used by the tickless timer. */
+void
+thread_account_idle (int64_t ticks) {
+	enum intr_level old_level = seqlock_write_lock (&stats_seq);
+	idle_ticks += ticks;
+	seqlock_write_unlock (&stats_seq, old_level);
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) {
+	struct list_elem *e;
+	long long misses = rt_exited_misses;
+	long long idle, kernel, user;
+	unsigned seq;
+
+	do {
+		seq = seqlock_read_begin (&stats_seq);
+		idle = idle_ticks;
+		kernel = kernel_ticks;
+		user = user_ticks;
+	} while (seqlock_read_retry (&stats_seq, seq));
+
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-			idle_ticks, kernel_ticks, user_ticks);
+			idle, kernel, user);
+
+	for (e = list_begin (&rt_threads); e != list_end (&rt_threads);
+			e = list_next (e))
+		misses += list_entry (e, struct thread, rt_list_elem)->rt_misses;
+	if (misses == 0)
+		return;
+	printf ("Real-time: %lld deadline misses\n", misses);
+	for (e = list_begin (&rt_threads); e != list_end (&rt_threads);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, rt_list_elem);
+		printf ("  %s: %d deadline misses\n", t->name, t->rt_misses);
+	}
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -210,27 +337,21 @@ thread_create (const char *name, int priority,
 	struct thread *t;
 	tid_t tid;
 
-	ASSERT (function != NULL);
-
-	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = thread_alloc (name, priority, function, aux);
 	if (t == NULL)
 		return TID_ERROR;
-
-	/* Initialize thread. */
-	init_thread (t, name, priority);
-	tid = t->tid = allocate_tid ();
-
-	/* Call the kernel_thread if it scheduled.
-	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
-	t->tf.rip = (uintptr_t) kernel_thread;
-	t->tf.R.rdi = (uint64_t) function;
-	t->tf.R.rsi = (uint64_t) aux;
-	t->tf.ds = SEL_KDSEG;
-	t->tf.es = SEL_KDSEG;
-	t->tf.ss = SEL_KDSEG;
-	t->tf.cs = SEL_KCSEG;
-	t->tf.eflags = FLAG_IF;
+	tid = t->tid;
+
+	/* Under MLFQS the priority is computed, not chosen.  The idle
+	   thread keeps PRI_MIN, since it never enters the ready queues
+	   after it first runs. */
+	if (thread_mlfqs && function != idle) {
+		struct thread *parent = thread_current ();
+		t->nice = parent->nice;
+		t->recent_cpu = parent->recent_cpu;
+		t->recent_cpu_sec = parent->recent_cpu_sec;
+		mlfqs_update_priority (t);
+	}
 
 	/* Add to run queue. */
 	thread_unblock (t);
@@ -239,6 +360,94 @@ thread_create (const char *name, int priority,
 	return tid;
 }
 
+/* Creates a new real-time kernel thread named NAME, which
+   executes FUNCTION passing AUX as the argument.  In every PERIOD
+   timer ticks, starting now, the thread is guaranteed up to
+   BUDGET ticks of CPU time, provided the budgets of all real-time
+   threads add up to no more than their periods allow.  Returns
+   the thread identifier for the new thread, or TID_ERROR if
+   creation fails.
+
+   Real-time threads are scheduled earliest deadline first, ahead
+   of all other threads, and have priority PRI_MAX when waiting on
+   a semaphore or lock.  Once a thread has used BUDGET ticks in a
+   period, it does not run again until the next period starts.
+   Call thread_rt_wait_period() to give up the rest of the
+   period once the work for it is done. */
+tid_t
+thread_create_rt (const char *name, int64_t period, int64_t budget,
+		thread_func *function, void *aux) {
+	struct thread *t;
+	enum intr_level old_level;
+	tid_t tid;
+
+	ASSERT (0 < budget && budget <= period);
+
+	t = thread_alloc (name, PRI_MAX, function, aux);
+	if (t == NULL)
+		return TID_ERROR;
+	tid = t->tid;
+
+	t->rt = true;
+	t->rt_period = period;
+	t->rt_budget = t->rt_remaining = budget;
+	timer_setup (&t->rt_timer, rt_period_start, t);
+
+	old_level = intr_disable ();
+	list_push_back (&rt_threads, &t->rt_list_elem);
+	t->rt_deadline = timer_ticks () + period;
+	timer_add (&t->rt_timer, t->rt_deadline);
+	thread_unblock (t);
+	intr_set_level (old_level);
+
+	check_and_preempt ();
+	return tid;
+}
+
+/* Blocks the running real-time thread until its next period
+   starts. */
+void
+thread_rt_wait_period (void) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (!intr_context ());
+	ASSERT (cur->rt);
+
+	old_level = intr_disable ();
+	cur->rt_waiting = true;
+	thread_block ();
+	intr_set_level (old_level);
+}
+
+/* Timer function that ends the current period of real-time
+   thread T_ and starts the next one with a full budget. */
+static void
+rt_period_start (void *t_) {
+	struct thread *t = t_;
+	bool runnable = t->status == THREAD_READY || t->status == THREAD_RUNNING;
+
+	if (runnable && !t->rt_throttled && t->rt_remaining > 0)
+		t->rt_misses++;
+
+	/* A thread in rt_queue must be requeued under its new
+	   deadline; a throttled one was left out of it. */
+	if (t->status == THREAD_READY && !t->rt_throttled)
+		ready_queue_remove (t);
+	t->rt_deadline += t->rt_period;
+	t->rt_remaining = t->rt_budget;
+	t->rt_throttled = false;
+	if (t->status == THREAD_READY)
+		ready_queue_push (t);
+	timer_add (&t->rt_timer, t->rt_deadline);
+
+	if (t->rt_waiting) {
+		t->rt_waiting = false;
+		thread_unblock (t);
+	}
+	check_and_preempt ();
+}
+
 /* Puts the current thread to sleep.  It will not be scheduled
    again until awoken by thread_unblock().
 
@@ -249,6 +458,7 @@ void
 thread_block (void) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!preempt_disabled ());
 	thread_current ()->status = THREAD_BLOCKED;
 	schedule ();
 }
@@ -269,10 +479,11 @@ thread_unblock (struct thread *t) {
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-
-	//list_push_back (&ready_list, &t->elem);
-  	list_insert_ordered(&ready_list, &t->elem, thread_priority_cmp, NULL);
-
+	if (thread_mlfqs && t != idle_thread)
+		mlfqs_catch_up (t);
+	if (thread_stride && t->pass < stride_pass)
+		t->pass = stride_pass;
+	ready_queue_push (t);
 	t->status = THREAD_READY;
 	intr_set_level (old_level);
 }
@@ -316,19 +527,26 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+	malloc_thread_exit ();
+	thread_cache_trim ();
 
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
+	list_remove (&thread_current ()->tid_elem);
+	if (thread_current ()->mlfqs_dirty)
+		list_remove (&thread_current ()->dirty_elem);
+	if (thread_current ()->rt) {
+		timer_cancel (&thread_current ()->rt_timer);
+		list_remove (&thread_current ()->rt_list_elem);
+		rt_exited_misses += thread_current ()->rt_misses;
+	}
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
 
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
-// Priority scheduling의 구현을 위해서는,
-// 현재 실행 중인 스레드가 idle_thread가 아니면, 
-// ready_list에 다시 삽입할 때 우선순위에 따라 정렬되도록 해야 함.
 void
 thread_yield (void) {
 	struct thread *curr = thread_current ();
@@ -338,14 +556,18 @@ thread_yield (void) {
 
 	old_level = intr_disable ();
 	if (curr != idle_thread)
-		// list_push_back (&ready_list, &curr->elem);
-    	list_insert_ordered(&ready_list, &curr->elem, thread_priority_cmp, NULL);
+		ready_queue_push (curr);
 
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
 }
 
 
+/* Puts the current thread to sleep until the timer tick reaches
+   END_TICK, or a little later, as the thread's timer slack
+   allows, if that lets it wake together with other sleepers.  The
+   thread's own kernel timer wakes it up, so arming and firing
+   cost O(1) regardless of how many threads sleep. */
 void thread_sleep(int64_t end_tick){
     enum intr_level old_level;
     struct thread *cur = thread_current();
@@ -354,160 +576,569 @@ void thread_sleep(int64_t end_tick){
     ASSERT(cur != idle_thread);
 
     old_level = intr_disable();
-    cur->wakeup_tick = end_tick; // 쓰레드에 종료틱 설정
-
-    // lock_acquire(&sleep_lock); 
-    list_insert_ordered(&sleep_list, &cur->elem, thread_wakeup_tick_cmp, NULL); // 슬립리스트에 종료틱 오름차순으로 삽입
-    // lock_release(&sleep_lock);
+    timer_setup(&cur->sleep_timer, thread_wakeup, cur);
+    timer_add_slack(&cur->sleep_timer, end_tick,
+            cur->timer_slack * TIMER_FREQ / 1000000000); // timer wheel에 종료틱 등록
 
     thread_block(); // 현재 쓰레드 블록
 
     intr_set_level(old_level);
 }
 
-
-void thread_check_sleep_list(){
-    enum intr_level old_level;
-    struct thread *t;
-    old_level = intr_disable();
-    int64_t ticks = timer_ticks();
-	
-    while (!list_empty(&sleep_list)) { // 슬립 리스트에서 꺠울 쓰레드 탐색
-        t = list_entry(list_front(&sleep_list), struct thread, elem); // 슬립 리스트 맨 앞 쓰레드 조회
-        if (t->wakeup_tick > ticks) { // 쓰레드가 현재 글로벌 틱보다 크다면 탐색 종료
-            break;
-        }
-        list_pop_front(&sleep_list); // 쓰레드가 현재 글로벌 틱보다 작거나 같다면 슬립 리스트에서 제거
-        thread_unblock(t); // 해당 쓰레드 언블록
-    }
-    // lock_release(&sleep_lock);
-    intr_set_level(old_level);
+/* Timer function for thread_sleep(): wakes up the sleeping
+   thread T_ from the timer interrupt.  Whether to preempt is
+   decided once, after every timer due on this tick has run. */
+static void
+thread_wakeup (void *t_) {
+    thread_unblock(t_);
 }
 
 /* Sets the current thread's priority to NEW_PRIORITY. */
 // 현재 스레드의 우선순위가 변경되어 더 이상 가장 높은 우선순위가 아니라면, CPU를 양보시켜야 함.
 void
 thread_set_priority (int new_priority) {
-	thread_current ()->priority = new_priority;
+	/* The MLFQS scheduler computes priorities on its own. */
+	if (thread_mlfqs)
+		return;
 
+	/* Interrupt handlers never change the running thread's
+	   priority or holds, so keeping other threads off the CPU is
+	   enough. */
+	preempt_disable ();
 	/** project1-Priority Inversion Problem */
-    thread_current()->original_priority = new_priority;
+	thread_current ()->original_priority = new_priority;
 
 	/** project1-Priority Inversion Problem */
-    refresh_priority();
+	refresh_priority ();
+	preempt_enable ();
 
 	/** project1-Priority Scheduling */
 	check_and_preempt();
 }
 
 
-void
-thread_set_priority_orig (int new_priority) {
-  struct thread* front_ready_thread = list_entry(list_begin(&ready_list), struct thread, elem);
-
-  thread_current ()->priority = new_priority;
-
-  if (front_ready_thread->priority > new_priority)
-    thread_yield();
-}
-
-
 /* Returns the current thread's priority. */
 int
 thread_get_priority (void) {
 	return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority.  Yields if it no longer has the highest
+   priority. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_set_nice (int nice) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+	old_level = intr_disable ();
+	cur->nice = nice;
+	if (thread_mlfqs)
+		mlfqs_update_priority (cur);
+	intr_set_level (old_level);
+
+	check_and_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int load = fp_to_int_round (fp_mul_int (load_avg, 100));
+	intr_set_level (old_level);
+	return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int recent = fp_to_int_round (fp_mul_int (thread_current ()->recent_cpu, 100));
+	intr_set_level (old_level);
+	return recent;
+}
+
+/* Sets the current thread's tickets to TICKETS.  Under the
+   stride scheduler, the thread's share of the CPU is proportional
+   to its tickets. */
+void
+thread_set_tickets (int tickets) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (TICKETS_MIN <= tickets && tickets <= TICKETS_MAX);
+
+	old_level = intr_disable ();
+	cur->tickets = tickets;
+	cur->stride = STRIDE1 / tickets;
+	intr_set_level (old_level);
+}
+
+/* Returns the current thread's tickets. */
+int
+thread_get_tickets (void) {
+	return thread_current ()->tickets;
+}
+
+/* Lets the current thread's sleeps end up to SLACK nanoseconds
+   late, so that the timer code can wake it in one batch with
+   other threads whose deadlines are near.  Threads created
+   afterward inherit it. */
+void
+thread_set_timer_slack (int64_t slack) {
+	ASSERT (slack >= 0);
+
+	thread_current ()->timer_slack = slack;
+}
+
+/* Returns the current thread's timer slack, in nanoseconds. */
+int64_t
+thread_get_timer_slack (void) {
+	return thread_current ()->timer_slack;
+}
+
+/*-- Advanced scheduler (MLFQS) 과제 --*/
+/* Queues T for a priority update at the next MLFQS_PRI_INTERVAL
+   boundary, unless it is already queued. */
+static void
+mlfqs_mark_dirty (struct thread *t) {
+	if (!t->mlfqs_dirty) {
+		t->mlfqs_dirty = true;
+		list_push_back (&mlfqs_dirty_list, &t->dirty_elem);
+	}
+}
+
+/* Applies one second's decay with coefficient COEF to T's
+   recent_cpu. */
+static void
+mlfqs_decay (struct thread *t, fixed_t coef) {
+	t->recent_cpu = fp_add_int (fp_mul (coef, t->recent_cpu), t->nice);
+}
+
+/* Does the once-per-second update: recomputes load_avg, records
+   this second's decay coefficient and applies it to every
+   runnable thread.  CUR is the running thread. */
+static void
+mlfqs_second (struct thread *cur) {
+	int ready_threads = ready_cnt + (cur != idle_thread);
+	fixed_t coef;
+	uint64_t mask;
+
+	load_avg = fp_div_int (fp_add_int (fp_mul_int (load_avg, 59), ready_threads), 60);
+	coef = fp_div (fp_mul_int (load_avg, 2), fp_add_int (fp_mul_int (load_avg, 2), 1));
+	mlfqs_seconds++;
+	decay_hist[mlfqs_seconds % DECAY_HIST] = coef;
+
+	if (cur != idle_thread) {
+		mlfqs_decay (cur, coef);
+		cur->recent_cpu_sec = mlfqs_seconds;
+		mlfqs_mark_dirty (cur);
+	}
+	for (mask = ready_mask; mask != 0; mask &= mask - 1) {
+		struct list *q = &ready_queues[__builtin_ctzll (mask)];
+		struct list_elem *e;
+
+		for (e = list_begin (q); e != list_end (q); e = list_next (e)) {
+			struct thread *t = list_entry (e, struct thread, elem);
+			mlfqs_decay (t, coef);
+			t->recent_cpu_sec = mlfqs_seconds;
+			mlfqs_mark_dirty (t);
+		}
+	}
+}
+
+/* MLFQS bookkeeping for one timer tick, in which CUR ran. */
+static void
+mlfqs_tick (struct thread *cur) {
+	int64_t now = timer_ticks ();
+
+	if (cur != idle_thread && !cur->rt) {
+		cur->recent_cpu = fp_add_int (cur->recent_cpu, 1);
+		mlfqs_mark_dirty (cur);
+	}
+
+	/* More than one second may have gone by if the tick was
+	   stopped while idle. */
+	while (mlfqs_seconds < now / TIMER_FREQ)
+		mlfqs_second (cur);
+
+	if (now % MLFQS_PRI_INTERVAL == 0) {
+		while (!list_empty (&mlfqs_dirty_list)) {
+			struct thread *t = list_entry (list_pop_front (&mlfqs_dirty_list),
+					struct thread, dirty_elem);
+			t->mlfqs_dirty = false;
+			mlfqs_update_priority (t);
+		}
+		if (cur != idle_thread && !cur->rt
+				&& cur->priority < ready_queue_max_priority ())
+			intr_yield_on_return ();
+	}
 }
 
+/* Sets T's priority from its recent_cpu and nice values. */
+static void
+mlfqs_update_priority (struct thread *t) {
+	int priority = PRI_MAX - fp_to_int (fp_div_int (t->recent_cpu, 4))
+		- t->nice * 2;
+
+	if (priority < PRI_MIN)
+		priority = PRI_MIN;
+	else if (priority > PRI_MAX)
+		priority = PRI_MAX;
+	set_priority (t, priority);
+}
+
+/* Brings the recent_cpu of T, which was blocked, up to date with
+   the per-second decays it missed, then recomputes its priority.
+   Seconds older than the decay history are assumed to have had
+   the oldest coefficient still known, and are applied in closed
+   form: after K seconds with coefficient C,
+   recent_cpu = C^K * recent_cpu + nice * (1 - C^K) / (1 - C). */
+static void
+mlfqs_catch_up (struct thread *t) {
+	int64_t gap = mlfqs_seconds - t->recent_cpu_sec;
+	int64_t sec;
+
+	if (gap <= 0)
+		return;
+
+	if (gap > DECAY_HIST - 1) {
+		int64_t k = gap - (DECAY_HIST - 1);
+		fixed_t coef = decay_hist[(mlfqs_seconds - (DECAY_HIST - 2)) % DECAY_HIST];
+		fixed_t coef_k = fp_pow_int (coef, k);
+
+		t->recent_cpu = fp_mul (coef_k, t->recent_cpu);
+		if (coef < FP_ONE)
+			t->recent_cpu = fp_add (t->recent_cpu, fp_mul_int (
+					fp_div (FP_ONE - coef_k, FP_ONE - coef), t->nice));
+		else
+			t->recent_cpu = fp_add_int (t->recent_cpu, t->nice * k);
+		gap = DECAY_HIST - 1;
+	}
+	for (sec = mlfqs_seconds - gap + 1; sec <= mlfqs_seconds; sec++)
+		mlfqs_decay (t, decay_hist[sec % DECAY_HIST]);
+	t->recent_cpu_sec = mlfqs_seconds;
+	mlfqs_update_priority (t);
+}
+/*-- Advanced scheduler (MLFQS) 과제 --*/
 
 /*-- Priority donation 과제 --*/
-void donate_priority() {
-    struct thread *t = thread_current();
-    int priority = t->priority;
+/* Priority donation.
+
+   Every lock, and every hold on a reader-writer lock, has a
+   struct lock_hold that caches the highest priority among the
+   threads waiting for the lock, which are kept in max-heaps (the
+   waiters of semaphores).  Every thread keeps its holds in the
+   max-heap held_locks, ordered by that cached priority, so its
+   effective priority is the larger of its original priority and
+   the top of held_locks.  A change in the waiters of a lock
+   therefore costs O(log n) per holder along the chain of holders
+   it propagates through, and the chain may be of any length.  A
+   reader-writer lock held for reading has several holders; each
+   of them receives the donation.  All of these functions must be
+   called with interrupts off. */
+
+static void rw_donate_priority (struct rwlock *);
+
+/* Returns the highest priority of the threads in WAITERS, or
+   PRI_MIN if there are none. */
+static int
+waiters_priority (struct heap *waiters) {
+	if (heap_empty (waiters))
+		return PRI_MIN;
+	return heap_entry (heap_top (waiters), struct thread, wait_elem)->priority;
+}
+
+/* Returns the highest priority of the threads waiting for RW. */
+static int
+rwlock_waiters_priority (struct rwlock *rw) {
+	int readers = waiters_priority (&rw->read_sema.waiters);
+	int writers = waiters_priority (&rw->write_sema.waiters);
+
+	return readers > writers ? readers : writers;
+}
+
+/* Returns T's priority including donations. */
+static int
+effective_priority (struct thread *t) {
+	int priority = t->original_priority;
+
+	if (!heap_empty (&t->held_locks)) {
+		struct lock_hold *hold = heap_entry (heap_top (&t->held_locks),
+				struct lock_hold, elem);
+		if (hold->priority > priority)
+			priority = hold->priority;
+	}
+	return priority;
+}
 
-    for (int depth = 0; depth < 8; depth++) {
-        if (t->wait_lock == NULL)
-            break;
+/* Orders holds by donated priority, highest first. */
+static bool
+held_lock_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct lock_hold *a = heap_entry (a_, struct lock_hold, elem);
+	const struct lock_hold *b = heap_entry (b_, struct lock_hold, elem);
 
-        t = t->wait_lock->holder;
-        t->priority = priority;
-    }
+	return a->priority > b->priority;
 }
 
-void remove_with_lock(struct lock *lock)  {
-    struct thread *t = thread_current();
-    struct list_elem *curr = list_begin(&t->donations);
-    struct thread *curr_thread = NULL;
+/* Sets the priority donated through HOLD, one of HOLDER's holds,
+   to PRIORITY, and updates HOLDER's priority to match.  Returns
+   true if HOLDER's priority changed. */
+static bool
+update_hold (struct thread *holder, struct lock_hold *hold, int priority) {
+	if (priority == hold->priority)
+		return false;
+	heap_remove (&holder->held_locks, &hold->elem);
+	hold->priority = priority;
+	heap_push (&holder->held_locks, &hold->elem);
 
-    while (curr != list_end(&t->donations))  {
-        curr_thread = list_entry(curr, struct thread, donation_elem);
-        struct list_elem *next = list_next(curr);
+	priority = effective_priority (holder);
+	if (priority == holder->priority)
+		return false;
+	set_priority (holder, priority);
+	return true;
+}
 
-        if (curr_thread->wait_lock == lock)
-            list_remove(&curr_thread->donation_elem);
+/* Called after the waiters of LOCK changed.  Updates the priority
+   LOCK donates to its holder, and carries any resulting change in
+   the holder's priority on to the holder of the lock it is
+   waiting for, and so on up the chain.  Each holder is moved to
+   its new place in the ready queues or in the waiters of the lock
+   it is blocked on. */
+void
+donate_priority (struct lock *lock) {
+	ASSERT (intr_get_level () == INTR_OFF);
 
-        curr = next;
-    }
+	while (lock != NULL && lock->holder != NULL) {
+		struct thread *holder = lock->holder;
+
+		if (!update_hold (holder, &lock->hold, waiters_priority (&lock->semaphore.waiters)))
+			break;
+		if (holder->wait_rwlock != NULL) {
+			rw_donate_priority (holder->wait_rwlock);
+			break;
+		}
+		lock = holder->wait_lock;
+	}
 }
 
-void refresh_priority(void)  {
-    struct thread *t = thread_current();
-    t->priority = t->original_priority;
+/* Called after the waiters of RW changed.  Like donate_priority(),
+   but donates to every holder of RW. */
+static void
+rw_donate_priority (struct rwlock *rw) {
+	int priority = rwlock_waiters_priority (rw);
+	struct list_elem *e;
+
+	if (rw->writer != NULL && update_hold (rw->writer, &rw->write_hold, priority))
+		donate_priority_from (rw->writer);
+	for (e = list_begin (&rw->read_holds); e != list_end (&rw->read_holds);
+			e = list_next (e)) {
+		struct rw_read_hold *h = list_entry (e, struct rw_read_hold, elem);
+
+		if (update_hold (h->holder, &h->hold, priority))
+			donate_priority_from (h->holder);
+	}
+}
 
-    if (list_empty(&t->donations))
-        return;
+/* Called after T joined the waiters of a lock or reader-writer
+   lock, or after its priority changed while it was waiting, to
+   pass its priority on to the holders. */
+void
+donate_priority_from (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
 
-    list_sort(&t->donations, thread_priority_cmp, NULL);
+	if (t->wait_lock != NULL)
+		donate_priority (t->wait_lock);
+	else if (t->wait_rwlock != NULL)
+		rw_donate_priority (t->wait_rwlock);
+}
 
-    struct list_elem *max_elem = list_front(&t->donations);
-    struct thread *max_thread = list_entry(max_elem, struct thread, donation_elem);
+/* Adds HOLD to the running thread's holds, donating PRIORITY. */
+static void
+add_hold (struct lock_hold *hold, int priority) {
+	hold->priority = priority;
+	heap_push (&thread_current ()->held_locks, &hold->elem);
+	if (!thread_mlfqs)
+		refresh_priority ();
+}
 
-    if (t->priority < max_thread->priority)
-        t->priority = max_thread->priority;
+/* Removes HOLD from the running thread's holds. */
+static void
+remove_hold (struct lock_hold *hold) {
+	heap_remove (&thread_current ()->held_locks, &hold->elem);
+	if (!thread_mlfqs)
+		refresh_priority ();
+}
+
+/* Records that the running thread has just acquired LOCK, and
+   takes on the priority of the threads still waiting for it. */
+void
+add_held_lock (struct lock *lock) {
+	ASSERT (intr_get_level () == INTR_OFF || preempt_disabled ());
+
+	add_hold (&lock->hold, waiters_priority (&lock->semaphore.waiters));
+}
+
+/* Records that the running thread is releasing LOCK, and drops
+   the priority donated through it. */
+void
+remove_held_lock (struct lock *lock) {
+	ASSERT (intr_get_level () == INTR_OFF || preempt_disabled ());
+
+	remove_hold (&lock->hold);
+}
+
+/* Records that the running thread has just acquired RW, for
+   writing if WRITING is true, otherwise for reading.  A thread may
+   hold at most RW_READ_HOLD_MAX reader-writer locks for reading at
+   once. */
+void
+add_held_rwlock (struct rwlock *rw, bool writing) {
+	struct thread *cur = thread_current ();
+	int priority = rwlock_waiters_priority (rw);
+	struct rw_read_hold *h;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (writing) {
+		add_hold (&rw->write_hold, priority);
+		return;
+	}
+
+	for (h = cur->read_holds; h < cur->read_holds + RW_READ_HOLD_MAX; h++)
+		if (h->rwlock == NULL) {
+			h->rwlock = rw;
+			h->holder = cur;
+			list_push_back (&rw->read_holds, &h->elem);
+			add_hold (&h->hold, priority);
+			return;
+		}
+	PANIC ("%s holds more than %d reader-writer locks for reading",
+			cur->name, RW_READ_HOLD_MAX);
+}
+
+/* Records that the running thread is releasing RW, which it holds
+   for writing if WRITING is true, otherwise for reading. */
+void
+remove_held_rwlock (struct rwlock *rw, bool writing) {
+	struct thread *cur = thread_current ();
+	struct rw_read_hold *h;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (writing) {
+		remove_hold (&rw->write_hold);
+		return;
+	}
+
+	for (h = cur->read_holds; h < cur->read_holds + RW_READ_HOLD_MAX; h++)
+		if (h->rwlock == rw) {
+			h->rwlock = NULL;
+			list_remove (&h->elem);
+			remove_hold (&h->hold);
+			return;
+		}
+	NOT_REACHED ();
+}
+
+/* Recomputes the running thread's priority from its original
+   priority and the donations it receives. */
+void
+refresh_priority (void) {
+	struct thread *t = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF || preempt_disabled ());
+
+	t->priority = effective_priority (t);
 }
 
 /*-- Priority CondVar 과제 --*/
-// 현재 실행 중인 스레드(curr)보다 더 높은 우선순위를 가진 스레드가 ready_list의 가장 앞에 있다면
+// 현재 실행 중인 스레드(curr)보다 더 높은 우선순위를 가진 스레드가 ready queue에 있다면
 // 즉시 CPU를 양보(thread_yield())하도록 만듦.
+// 인터럽트 핸들러 안에서는 바로 양보할 수 없으므로 인터럽트 리턴 시점으로 미룸.
 void check_and_preempt (void) {
+	struct thread *cur = thread_current ();
+	bool preempt;
+
 	// 얼리 리턴
-	if (thread_current() == idle_thread)
+	if (cur == idle_thread)
+		return;
+
+	// 실시간(EDF) 스레드는 일반 스레드보다 항상 먼저, 실시간 스레드끼리는 데드라인 순으로 선점.
+	if (!heap_empty (&rt_queue))
+		preempt = !cur->rt || rt_less (heap_top (&rt_queue), &cur->rt_elem, NULL);
+	else if (cur->rt || ready_mask == 0)
 		return;
-	if (list_empty(&ready_list))
+	// ready queue에 현재 실행 중인 스레드보다 우선순위가 높은 스레드가 있으면 양보시킴.
+	else
+		preempt = cur->priority < ready_queue_max_priority ();
+
+	if (preempt) {
+		if (intr_context ())
+			intr_yield_on_return ();
+		else
+			thread_preempt ();
+	}
+}
+
+/* Yields the CPU to a higher-priority thread that became ready.
+   If the running thread has disabled preemption, only notes that
+   it should yield, which preempt_enable() then does at the end of
+   its critical section. */
+void
+thread_preempt (void) {
+	struct thread *t = thread_current ();
+
+	ASSERT (!intr_context ());
+
+	if (t->preempt_count > 0) {
+		t->need_resched = true;
 		return;
+	}
+	t->need_resched = false;
+	thread_yield ();
+}
+
+/* Keeps the running thread on the CPU until the matching
+   preempt_enable().  Unlike intr_disable(), this leaves interrupts
+   on: a thread woken meanwhile, even one of higher priority, only
+   gets the CPU once preemption is enabled again.  This is enough to
+   protect data that other threads modify but interrupt handlers
+   never touch.  Calls nest.  The thread must not sleep in
+   between. */
+void
+preempt_disable (void) {
+	thread_current ()->preempt_count++;
+	barrier ();
+}
+
+/* Undoes one preempt_disable().  When the last one is undone,
+   yields right away if a higher-priority thread was woken in the
+   meantime. */
+void
+preempt_enable (void) {
+	struct thread *t = thread_current ();
 
-	// Preempt 들어가야 할지 확인해야 할 경우
-	struct thread *curr = thread_current();
-	struct thread *ready = list_entry(list_front(&ready_list), struct thread, elem);
+	ASSERT (t->preempt_count > 0);
 
-	if (curr->priority < ready->priority)
-		thread_yield(); // ready_list에 현재 실행 중인 스레드보다 우선순위가 높은 스레드가 있으면 양보시킴.
+	barrier ();
+	if (--t->preempt_count == 0 && t->need_resched && !intr_context ())
+		thread_preempt ();
+}
+
+/* Returns true if the running thread has disabled preemption. */
+bool
+preempt_disabled (void) {
+	return thread_current ()->preempt_count > 0;
 }
 /*-- Priority CondVar 과제 --*/
 /*-- Priority donation 과제 --*/
@@ -534,6 +1165,11 @@ idle (void *idle_started_ UNUSED) {
 		intr_disable ();
 		thread_block ();
 
+		/* In tickless mode, stop the periodic tick until the next
+		   timer deadline.  schedule() restarts it as soon as
+		   anything else gets to run. */
+		timer_idle_enter ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -575,14 +1211,209 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 
 	/*-- Priority donation 과제 --*/
-    t->priority = t->original_priority = priority;
-    list_init(&t->donations);
-    t->wait_lock = NULL;
+	t->priority = t->original_priority = priority;
+	heap_init (&t->held_locks, held_lock_less, NULL);
+	t->wait_lock = NULL;
 	/*-- Priority donation 과제 --*/
 
+	t->tickets = TICKETS_DEFAULT;
+	t->stride = STRIDE1 / TICKETS_DEFAULT;
+	t->timer_slack = TIMER_SLACK_DEFAULT;
+
 	t->magic = THREAD_MAGIC;
 }
 
+/* Allocates and initializes a new blocked kernel thread named
+   NAME with the given PRIORITY, which will execute FUNCTION
+   passing AUX as the argument once it is scheduled.  Returns the
+   new thread, or a null pointer if no memory is available. */
+static struct thread *
+thread_alloc (const char *name, int priority,
+		thread_func *function, void *aux) {
+	struct thread *t;
+
+	ASSERT (function != NULL);
+
+	/* Allocate thread. */
+	t = thread_page_get ();
+	if (t == NULL)
+		return NULL;
+
+	/* Initialize thread. */
+	init_thread (t, name, priority);
+	t->timer_slack = thread_current ()->timer_slack;
+	t->tid = allocate_tid ();
+	tid_table_insert (t);
+
+	/* Call the kernel_thread if it scheduled.
+	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
+	t->tf.rip = (uintptr_t) kernel_thread;
+	t->tf.R.rdi = (uint64_t) function;
+	t->tf.R.rsi = (uint64_t) aux;
+	t->tf.ds = SEL_KDSEG;
+	t->tf.es = SEL_KDSEG;
+	t->tf.ss = SEL_KDSEG;
+	t->tf.cs = SEL_KCSEG;
+	t->tf.eflags = FLAG_IF;
+
+	return t;
+}
+
+/* Returns a page to hold a new thread, preferably one recycled
+   from an exited thread, or a null pointer if no memory is
+   available.  The page is not cleared; init_thread() resets the
+   struct thread at its bottom. */
+static struct thread *
+thread_page_get (void) {
+	struct thread *t = NULL;
+	enum intr_level old_level = intr_disable ();
+
+	if (!list_empty (&thread_cache)) {
+		t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+		thread_cache_cnt--;
+	}
+	intr_set_level (old_level);
+
+	if (t == NULL)
+		t = palloc_get_page (0);
+	return t;
+}
+
+/* Puts the page of exited thread T into the thread cache.  Never
+   frees it, so it is safe to call from do_schedule(). */
+static void
+thread_page_put (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	/* Make stale pointers to T fail is_thread(). */
+	t->magic = 0;
+	list_push_front (&thread_cache, &t->elem);
+	thread_cache_cnt++;
+}
+
+/* Gives the least recently cached pages back to palloc until at
+   most THREAD_CACHE_MAX are left.  Must be called from thread
+   context, since freeing a page may block. */
+static void
+thread_cache_trim (void) {
+	ASSERT (!intr_context ());
+
+	for (;;) {
+		struct thread *t = NULL;
+		enum intr_level old_level = intr_disable ();
+
+		if (thread_cache_cnt > THREAD_CACHE_MAX) {
+			t = list_entry (list_pop_back (&thread_cache), struct thread, elem);
+			thread_cache_cnt--;
+		}
+		intr_set_level (old_level);
+
+		if (t == NULL)
+			break;
+		palloc_free_page (t);
+	}
+}
+
+/* Appends T to the tail of the ready queue for its priority, or,
+   under the stride scheduler, inserts it into the stride queue.
+   A real-time thread goes into the EDF queue instead, unless it is
+   throttled. */
+static void
+ready_queue_push (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t->rt) {
+		if (!t->rt_throttled) {
+			heap_push (&rt_queue, &t->rt_elem);
+			ready_cnt++;
+		}
+		return;
+	}
+	ready_cnt++;
+	if (thread_stride) {
+		heap_push (&stride_queue, &t->stride_elem);
+		return;
+	}
+	list_push_back (&ready_queues[t->priority], &t->elem);
+	ready_mask |= 1ULL << t->priority;
+}
+
+/* Removes T from the ready queue for its priority, or from the
+   stride queue.  T's priority must not have changed since it was
+   pushed. */
+static void
+ready_queue_remove (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	ready_cnt--;
+	if (t->rt) {
+		heap_remove (&rt_queue, &t->rt_elem);
+		return;
+	}
+	if (thread_stride) {
+		heap_remove (&stride_queue, &t->stride_elem);
+		return;
+	}
+	list_remove (&t->elem);
+	if (list_empty (&ready_queues[t->priority]))
+		ready_mask &= ~(1ULL << t->priority);
+}
+
+/* Returns the highest priority that has a ready thread, or -1 if
+   every ready queue is empty. */
+static int
+ready_queue_max_priority (void) {
+	if (ready_mask == 0)
+		return -1;
+	return 63 - __builtin_clzll (ready_mask);
+}
+
+/* Orders threads in the stride queue by pass, then by tid so
+   that equal passes are served in a fixed order. */
+static bool
+stride_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = heap_entry (a_, struct thread, stride_elem);
+	const struct thread *b = heap_entry (b_, struct thread, stride_elem);
+
+	if (a->pass != b->pass)
+		return a->pass < b->pass;
+	return a->tid < b->tid;
+}
+
+/* Orders real-time threads by deadline, then by tid. */
+static bool
+rt_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = heap_entry (a_, struct thread, rt_elem);
+	const struct thread *b = heap_entry (b_, struct thread, rt_elem);
+
+	if (a->rt_deadline != b->rt_deadline)
+		return a->rt_deadline < b->rt_deadline;
+	return a->tid < b->tid;
+}
+
+/* Sets T's priority to PRIORITY.  If T is in a ready queue, it is
+   moved to the tail of the queue for the new priority; if it is
+   waiting on a semaphore, it is moved among the waiters. */
+static void
+set_priority (struct thread *t, int priority) {
+	enum intr_level old_level;
+
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+	old_level = intr_disable ();
+	if (t->status == THREAD_READY && !t->rt && t->priority != priority) {
+		ready_queue_remove (t);
+		t->priority = priority;
+		ready_queue_push (t);
+	} else if (t->status == THREAD_BLOCKED && t->priority != priority)
+		sema_waiter_set_priority (t, priority);
+	else
+		t->priority = priority;
+	intr_set_level (old_level);
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
@@ -590,10 +1421,32 @@ init_thread (struct thread *t, const char *name, int priority) {
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
+	struct thread *t;
+	int pri;
+
+	if (!heap_empty (&rt_queue)) {
+		t = heap_entry (heap_top (&rt_queue), struct thread, rt_elem);
+		ready_queue_remove (t);
+		return t;
+	}
+
+	if (thread_stride) {
+		if (heap_empty (&stride_queue))
+			return idle_thread;
+		t = heap_entry (heap_top (&stride_queue), struct thread, stride_elem);
+		ready_queue_remove (t);
+		if (t->pass > stride_pass)
+			stride_pass = t->pass;
+		return t;
+	}
+
+	pri = ready_queue_max_priority ();
+	if (pri < 0)
 		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+	t = list_entry (list_front (&ready_queues[pri]), struct thread, elem);
+	ready_queue_remove (t);
+	return t;
 }
 
 
@@ -637,61 +1490,17 @@ do_iret (struct intr_frame *tf) {
    added at the end of the function. */
 static void
 thread_launch (struct thread *th) {
-	uint64_t tf_cur = (uint64_t) &running_thread ()->tf;
-	uint64_t tf = (uint64_t) &th->tf;
+	struct thread *curr = running_thread ();
+	uint64_t next_rsp = th->switch_rsp;
+
 	ASSERT (intr_get_level () == INTR_OFF);
 
-	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile (
-			/* Store registers that will be used. */
-			"push %%rax\n"
-			"push %%rbx\n"
-			"push %%rcx\n"
-			/* Fetch input once */
-			"movq %0, %%rax\n"
-			"movq %1, %%rcx\n"
-			"movq %%r15, 0(%%rax)\n"
-			"movq %%r14, 8(%%rax)\n"
-			"movq %%r13, 16(%%rax)\n"
-			"movq %%r12, 24(%%rax)\n"
-			"movq %%r11, 32(%%rax)\n"
-			"movq %%r10, 40(%%rax)\n"
-			"movq %%r9, 48(%%rax)\n"
-			"movq %%r8, 56(%%rax)\n"
-			"movq %%rsi, 64(%%rax)\n"
-			"movq %%rdi, 72(%%rax)\n"
-			"movq %%rbp, 80(%%rax)\n"
-			"movq %%rdx, 88(%%rax)\n"
-			"pop %%rbx\n"              // Saved rcx
-			"movq %%rbx, 96(%%rax)\n"
-			"pop %%rbx\n"              // Saved rbx
-			"movq %%rbx, 104(%%rax)\n"
-			"pop %%rbx\n"              // Saved rax
-			"movq %%rbx, 112(%%rax)\n"
-			"addq $120, %%rax\n"
-			"movw %%es, (%%rax)\n"
-			"movw %%ds, 8(%%rax)\n"
-			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
-			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
-			"movq %%rbx, 0(%%rax)\n" // rip
-			"movw %%cs, 8(%%rax)\n"  // cs
-			"pushfq\n"
-			"popq %%rbx\n"
-			"mov %%rbx, 16(%%rax)\n" // eflags
-			"mov %%rsp, 24(%%rax)\n" // rsp
-			"movw %%ss, 32(%%rax)\n"
-			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
-			);
+	/* Every thread gets switched out here, in kernel mode, so only
+	   its callee-saved registers and stack pointer need saving.  A
+	   thread switched out that way is resumed the same way; one
+	   that has never run is started from its whole intr_frame. */
+	th->switch_rsp = 0;
+	switch_threads (&curr->switch_rsp, next_rsp, &th->tf);
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -705,7 +1514,7 @@ do_schedule(int status) {
 	while (!list_empty (&destruction_req)) {
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		thread_page_put (victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
@@ -725,6 +1534,10 @@ schedule (void) {
 	/* Start new time slice. */
 	thread_ticks = 0;
 
+	/* Restart the periodic tick if idle had stopped it. */
+	if (curr == idle_thread)
+		timer_idle_exit ();
+
 #ifdef USERPROG
 	/* Activate the new address space. */
 	process_activate (next);
@@ -753,11 +1566,42 @@ schedule (void) {
 static tid_t
 allocate_tid (void) {
 	static tid_t next_tid = 1;
-	tid_t tid;
 
-	lock_acquire (&tid_lock);
-	tid = next_tid++;
-	lock_release (&tid_lock);
+	return __atomic_fetch_add (&next_tid, 1, __ATOMIC_RELAXED);
+}
 
-	return tid;
+/* Returns the bucket of the tid table that holds TID. */
+static struct list *
+tid_bucket (tid_t tid) {
+	return &tid_table[(unsigned) tid & (TID_TABLE_SIZE - 1)];
+}
+
+/* Adds T to the tid table. */
+static void
+tid_table_insert (struct thread *t) {
+	enum intr_level old_level = intr_disable ();
+	list_push_front (tid_bucket (t->tid), &t->tid_elem);
+	intr_set_level (old_level);
+}
+
+/* Returns the live thread whose tid is TID, or a null pointer if
+   there is none.  The thread may exit as soon as interrupts are
+   back on, so a caller that wants to use the result must call
+   this with interrupts off or otherwise keep the thread alive. */
+struct thread *
+thread_find (tid_t tid) {
+	struct list *bucket = tid_bucket (tid);
+	struct thread *found = NULL;
+	struct list_elem *e;
+	enum intr_level old_level = intr_disable ();
+
+	for (e = list_begin (bucket); e != list_end (bucket); e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, tid_elem);
+		if (t->tid == tid) {
+			found = t;
+			break;
+		}
+	}
+	intr_set_level (old_level);
+	return found;
 }
@@ -0,0 +1,164 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Number of work items each worker can have queued. */
+#define WORK_QUEUE_SIZE 64
+
+/* A queued work_queue() call. */
+struct work {
+	work_func *func;
+	void *aux;
+};
+
+/* A worker thread and its queue.  Everything here is only
+   touched with interrupts off. */
+struct worker {
+	struct thread *thread;      /* Worker thread, once it runs. */
+	bool idle;                  /* Blocked waiting for work? */
+	struct work queue[WORK_QUEUE_SIZE];  /* Ring buffer of work. */
+	unsigned head;              /* Next item to run. */
+	unsigned tail;              /* Next free slot. */
+	struct list tasklets;       /* Scheduled tasklets, WORK_HIGH only. */
+};
+
+static struct worker workers[WORK_PRIO_CNT];
+
+static thread_func worker_thread;
+static void worker_wake (struct worker *);
+
+/* Starts the worker threads.  Work queued before this runs once
+   they start. */
+void
+workqueue_init (void) {
+	static const struct {
+		const char *name;
+		int priority;
+	} params[WORK_PRIO_CNT] = {
+		[WORK_HIGH] = { "kworker/high", PRI_MAX },
+		[WORK_NORMAL] = { "kworker", PRI_DEFAULT },
+		[WORK_LOW] = { "kworker/low", PRI_MIN },
+	};
+	int i;
+
+	for (i = 0; i < WORK_PRIO_CNT; i++) {
+		list_init (&workers[i].tasklets);
+		if (thread_create (params[i].name, params[i].priority,
+					worker_thread, &workers[i]) == TID_ERROR)
+			PANIC ("could not start %s", params[i].name);
+	}
+}
+
+/* Queues FUNC (AUX) to run in the WORK_NORMAL worker.  Returns
+   false if its queue is full.  May be called from an interrupt
+   handler. */
+bool
+work_queue (work_func *func, void *aux) {
+	return work_queue_prio (WORK_NORMAL, func, aux);
+}
+
+/* Queues FUNC (AUX) to run in the worker of priority PRIO.
+   Returns false if its queue is full.  May be called from an
+   interrupt handler. */
+bool
+work_queue_prio (enum work_prio prio, work_func *func, void *aux) {
+	struct worker *w;
+	enum intr_level old_level;
+	bool queued = false;
+
+	ASSERT (prio < WORK_PRIO_CNT);
+	ASSERT (func != NULL);
+
+	w = &workers[prio];
+	old_level = intr_disable ();
+	if (w->tail - w->head < WORK_QUEUE_SIZE) {
+		w->queue[w->tail++ % WORK_QUEUE_SIZE] = (struct work) { func, aux };
+		worker_wake (w);
+		queued = true;
+	}
+	intr_set_level (old_level);
+
+	return queued;
+}
+
+/* Initializes tasklet T to call FUNC (AUX). */
+void
+tasklet_init (struct tasklet *t, work_func *func, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (func != NULL);
+
+	t->func = func;
+	t->aux = aux;
+	t->scheduled = false;
+}
+
+/* Schedules T to run in the WORK_HIGH worker, unless it is
+   already scheduled and has not started yet.  Scheduling it while
+   it runs makes it run once more.  May be called from an
+   interrupt handler. */
+void
+tasklet_schedule (struct tasklet *t) {
+	struct worker *w = &workers[WORK_HIGH];
+	enum intr_level old_level;
+
+	ASSERT (t != NULL);
+	ASSERT (t->func != NULL);
+
+	old_level = intr_disable ();
+	if (!t->scheduled) {
+		t->scheduled = true;
+		list_push_back (&w->tasklets, &t->elem);
+		worker_wake (w);
+	}
+	intr_set_level (old_level);
+}
+
+/* Wakes up W's thread if it is waiting for work.  Must be called
+   with interrupts off. */
+static void
+worker_wake (struct worker *w) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (w->idle) {
+		w->idle = false;
+		thread_unblock (w->thread);
+		check_and_preempt ();
+	}
+}
+
+/* Worker thread: runs the tasklets and work queued on worker W_,
+   one at a time and with interrupts on, and blocks when there is
+   none. */
+static void
+worker_thread (void *w_) {
+	struct worker *w = w_;
+
+	intr_disable ();
+	w->thread = thread_current ();
+	for (;;) {
+		work_func *func;
+		void *aux;
+
+		while (list_empty (&w->tasklets) && w->head == w->tail) {
+			w->idle = true;
+			thread_block ();
+		}
+
+		if (!list_empty (&w->tasklets)) {
+			struct tasklet *t = list_entry (list_pop_front (&w->tasklets),
+					struct tasklet, elem);
+			t->scheduled = false;
+			func = t->func;
+			aux = t->aux;
+		} else {
+			struct work *work = &w->queue[w->head++ % WORK_QUEUE_SIZE];
+			func = work->func;
+			aux = work->aux;
+		}
+
+		intr_enable ();
+		func (aux);
+		intr_disable ();
+	}
+}